@@ -29,6 +29,22 @@ bool SystemConfig::SetConf(const std::string& conf_name, const Configuration& co
     
     v = conf.GetValue("io_thread_pool_size");
     if (v.isInt()) io_thread_pool_size = static_cast<uint32_t>(v.asInt());
+    
+    v = conf.GetValue("takeover_path");
+    if (v.isString()) takeover_path = v.asString();
+    v = conf.GetValue("drain_timeout");
+    if (v.isInt()) drain_timeout = static_cast<uint32_t>(v.asInt());
+    v = conf.GetValue("redirect_host");
+    if (v.isString()) redirect_host = v.asString();
+    v = conf.GetValue("redirect_port");
+    if (v.isInt()) redirect_port = static_cast<uint32_t>(v.asInt());
+    v = conf.GetValue("redirect_timeout");
+    if (v.isInt()) redirect_timeout = static_cast<uint32_t>(v.asInt());
+    
+    v = conf.GetValue("net_memory_budget");
+    if (v.isInt()) net_memory_budget = static_cast<uint64_t>(v.asInt());
+    v = conf.GetValue("net_memory_shed");
+    if (v.isBool()) net_memory_shed = v.asBool();
 
     return true;
 }
@@ -21,6 +21,7 @@
 #include "nebula/base/configurable.h"
 
 #include <iostream>
+#include <string>
 #include <vector>
 
 namespace nebula {
@@ -39,6 +40,20 @@ struct SystemConfig : public Configurable {
                                             // 未设置：为一个核一个线程
                                             // n：为n个线程
     
+    // 平滑重启: 新旧进程交接监听socket的unix socket路径, 为空不启用
+    std::string takeover_path;
+    // 旧进程交出监听socket后等待连接断开的最长时间(毫秒)
+    uint32_t drain_timeout = {30000};
+    // 发给zproto客户端的Redirect, 为空则重连原地址(新进程); 超时单位为秒
+    std::string redirect_host;
+    uint32_t redirect_port = {0};
+    uint32_t redirect_timeout = {0};
+    
+    // 进程级网络缓冲预算(字节), 所有连接读缓冲和待发送数据之和, 0为不限制
+    uint64_t net_memory_budget = {0};
+    // 超预算时关闭占用最多的连接, 否则只暂停读
+    bool net_memory_shed = {false};
+    
     // uint32_t srv_number;                    // 服务器编号
     // 机房.集群.组.服务名.编号
 
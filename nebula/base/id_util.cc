@@ -22,6 +22,7 @@ namespace {
   
 uint16_t g_worker_id = 1;
 uint16_t g_data_center_id = 1;
+uint64_t g_epoch = snowflake4cxx::kDefaultEpoch;
 // uint32_t g_current_ms_id = 0;
   
 }
@@ -32,8 +33,24 @@ void    InitSnowflakeWorkerID(uint16_t worker_id, uint16_t data_center_id) {
 }
 
 
+void InitSnowflakeEpoch(uint64_t epoch) {
+  g_epoch = epoch;
+}
+
+namespace {
+
+snowflake4cxx::IdWorkerThreadSafe& GetIdWorker() {
+  static snowflake4cxx::IdWorkerThreadSafe g_id_worker(g_worker_id, g_data_center_id, g_epoch);
+  return g_id_worker;
+}
+
+}
+
 uint64_t GetNextIDBySnowflake() {
-  static snowflake4cxx::IdWorkerThreadSafe g_id_worker(g_worker_id, g_data_center_id);
-  return g_id_worker.GetNextID();
+  return GetIdWorker().GetNextID();
+}
+
+uint64_t GetNextIDsBySnowflake(uint32_t n) {
+  return GetIdWorker().GetNextIDs(n);
 }
 
@@ -20,10 +20,17 @@
 
 #include <stdint.h>
 
+// 必须在第一次调用GetNextIDBySnowflake之前设置
 void InitSnowflakeWorkerID(uint16_t worker_id, uint16_t data_center_id=1);
+// epoch为毫秒时间戳, 默认为2017-01-01 00:00:00 UTC
+void InitSnowflakeEpoch(uint64_t epoch);
 
+// 线程安全, 无锁
 uint64_t GetNextIDBySnowflake();
 
+// 预留n个连续的ID, 返回第一个, n最大为4096
+uint64_t GetNextIDsBySnowflake(uint32_t n);
+
 // 非线程安全
 // uint64_t GetNextIDBySnowflakeUnSafe();
 
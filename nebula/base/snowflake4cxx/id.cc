@@ -24,42 +24,50 @@ namespace snowflake4cxx {
 
 namespace {
   
+using detail::kSequenceBits;
+using detail::kSequenceMask;
+using detail::Reserve;
+
+const uint64_t kTimestampMask = (1ULL << 41) - 1;
+
 // TODO(@benqi): 更高效的gettimeofday实现
 inline uint64_t NowInMsec() {
   timeval tv;
   gettimeofday(&tv, 0);
   return uint64_t(tv.tv_sec) * 1000 + tv.tv_usec/1000;
 }
-  
-uint64_t WaitUntilNextMillis(uint64_t last_timestamp) {
-  uint64_t timestamp = NowInMsec();
-  while (timestamp <= last_timestamp) {
-    timestamp = NowInMsec();
-  }
-  return timestamp;
+
+inline uint64_t MakeID(uint64_t first, uint16_t data_center_id, uint16_t worker_id) {
+  return (((first >> kSequenceBits) & kTimestampMask) << 22 |
+          (data_center_id & 0x1F) << 17 |
+          (worker_id & 0x1F) << 12 |
+          (first & kSequenceMask));
 }
 
+inline uint32_t ClampBatchSize(uint32_t n) {
+  return n == 0 ? 1 : (n > kMaxBatchSize ? kMaxBatchSize : n);
 }
 
-uint64_t IdWorkerUnThreadSafe::GetNextID() {
-  uint64_t timestamp = NowInMsec();
+}
+
+uint64_t IdWorkerUnThreadSafe::GetNextIDs(uint32_t n) {
+  uint64_t first = 0;
+  state_ = Reserve(state_, NowInMsec() - epoch_, ClampBatchSize(n), &first);
+  return MakeID(first, data_center_id_, worker_id_);
+}
+
+uint64_t IdWorkerThreadSafe::GetNextIDs(uint32_t n) {
+  n = ClampBatchSize(n);
+  uint64_t timestamp = NowInMsec() - epoch_;
+  uint64_t first = 0;
   
-  // 在当前秒内
-  if (last_timestamp_ == timestamp) {
-    sequence_ = (sequence_ + 1) & 0xFFF;
-    if (sequence_ == 0) {
-      timestamp = WaitUntilNextMillis(last_timestamp_);
-    }
-  } else {
-    sequence_ = 0;
+  uint64_t state = state_.load(std::memory_order_relaxed);
+  while (!state_.compare_exchange_weak(state,
+                                       Reserve(state, timestamp, n, &first),
+                                       std::memory_order_relaxed)) {
   }
   
-  last_timestamp_ = timestamp;
-  return ((timestamp & 0x1FFFFFF) << 22 |
-          (data_center_id_ & 0x1F) << 17 |
-          (worker_id_& 0x1F) << 12 |
-          (sequence_ & 0xFFF));
-  
+  return MakeID(first, data_center_id_, worker_id_);
 }
 
 }
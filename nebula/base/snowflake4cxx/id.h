@@ -25,7 +25,8 @@
 #define SNOWFLAKE4CXX_ID_WORKER_H_
 
 #include <stdint.h>
-#include <mutex>
+
+#include <atomic>
 
 namespace snowflake4cxx {
   
@@ -38,35 +39,92 @@ namespace snowflake4cxx {
 // 这样的好处是，整体上按照时间自增排序，并且整个分布式系统内不会产生ID碰撞（由datacenter和机器ID作区分），
 // 并且效率较高，经测试，snowflake每秒能够产生26万ID左右，完全满足需要。
 //
+// 时间为相对epoch的毫秒数, 41位可以用69年
+// 一毫秒内的4096个序号用完时不再忙等下一毫秒, 直接借用下一毫秒的序号,
+// 持续超发时时间会略超前于时钟, 压力下降后自然追平
+//
+
+// 默认epoch: 2017-01-01 00:00:00 UTC
+const uint64_t kDefaultEpoch = 1483228800000ULL;
+
+// GetNextIDs一次最多预留的ID数(一毫秒内的序号数)
+const uint32_t kMaxBatchSize = 4096;
+
+namespace detail {
+
+const uint64_t kSequenceBits = 12;
+const uint64_t kSequenceMask = (1ULL << kSequenceBits) - 1;
+
+// state: 高位为时间, 低12位为已分配的最后一个序号
+// 从state里预留n个序号, 返回新的state, first为第一个ID的时间和序号
+// 放在头文件里供id_test测试
+inline uint64_t Reserve(uint64_t state, uint64_t timestamp, uint32_t n, uint64_t* first) {
+  uint64_t last_timestamp = state >> kSequenceBits;
+  uint64_t sequence = 0;
+  
+  // 时钟回拨时沿用上次的时间, 保证单调
+  if (timestamp <= last_timestamp) {
+    timestamp = last_timestamp;
+    sequence = (state & kSequenceMask) + 1;
+    if (sequence + n > kSequenceMask + 1) {
+      // 当前毫秒的序号不够, 借用下一毫秒
+      ++timestamp;
+      sequence = 0;
+    }
+  }
+  
+  *first = timestamp << kSequenceBits | sequence;
+  return timestamp << kSequenceBits | (sequence + n - 1);
+}
+
+}
+
 class IdWorkerUnThreadSafe {
 public:
   // TODO(@benqi): 检查worker_id和data_center_id
-  IdWorkerUnThreadSafe(uint16_t worker_id, uint16_t data_center_id)
+  IdWorkerUnThreadSafe(uint16_t worker_id, uint16_t data_center_id, uint64_t epoch = kDefaultEpoch)
     : worker_id_(worker_id),
-      data_center_id_(data_center_id) {}
+      data_center_id_(data_center_id),
+      epoch_(epoch) {}
+  
+  uint64_t GetNextID() {
+    return GetNextIDs(1);
+  }
   
-  uint64_t GetNextID();
+  // 预留n个连续的ID, 返回第一个, 即[id, id+n)
+  // n取值为[1, kMaxBatchSize], 超过kMaxBatchSize按kMaxBatchSize处理
+  uint64_t GetNextIDs(uint32_t n);
   
 protected:
   uint16_t worker_id_{0};
   uint16_t data_center_id_{0};
-  uint64_t last_timestamp_{0};
-  uint32_t sequence_{0};
+  uint64_t epoch_{kDefaultEpoch};
+  // 高位为时间, 低12位为已分配的最后一个序号
+  uint64_t state_{0};
 };
 
+// 无锁实现, 时间和序号打包在一个64位整数里, 通过CAS更新
 class IdWorkerThreadSafe {
 public:
-  IdWorkerThreadSafe(uint16_t worker_id, uint16_t data_center_id)
-    : id_worker_(worker_id, data_center_id) {}
+  IdWorkerThreadSafe(uint16_t worker_id, uint16_t data_center_id, uint64_t epoch = kDefaultEpoch)
+    : worker_id_(worker_id),
+      data_center_id_(data_center_id),
+      epoch_(epoch) {}
   
   uint64_t GetNextID() {
-    std::lock_guard<std::mutex> g(mutex_);
-    return id_worker_.GetNextID();
+    return GetNextIDs(1);
   }
   
+  uint64_t GetNextIDs(uint32_t n);
+  
 protected:
-  IdWorkerUnThreadSafe id_worker_;
-  std::mutex mutex_;
+  uint16_t worker_id_{0};
+  uint16_t data_center_id_{0};
+  uint64_t epoch_{kDefaultEpoch};
+  
+  // 所有IO线程都会访问, 独占一个cache line
+  alignas(64) std::atomic<uint64_t> state_{0};
+  char pad_[64 - sizeof(std::atomic<uint64_t>)];
 };
 
 } // namespace snowflake4cxx
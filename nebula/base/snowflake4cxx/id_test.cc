@@ -16,11 +16,18 @@
  *
  */
 
+// 测试里assert始终生效
+#undef NDEBUG
+
 #include <sys/time.h>
 
+#include <algorithm>
+#include <cassert>
 #include <iostream>
+#include <thread>
+#include <vector>
 
-#include "snowflake4cxx/id.h"
+#include "nebula/base/snowflake4cxx/id.h"
 
 inline uint64_t GetNowInMsec() {
   timeval tv;
@@ -30,7 +37,115 @@ inline uint64_t GetNowInMsec() {
 
 using namespace snowflake4cxx;
 
+void PrintResult(const char* name, uint64_t c, uint64_t d) {
+  if (d == 0) {
+    d = 1;
+  }
+  std::cout << name << "> Executed: " << c << std::endl;
+  std::cout << name << "> duration: " << d << std::endl;
+  std::cout << name << "> avg: " << (uint64_t) (((double)c/d)*1000) << std::endl;
+}
+
+// state按(时间, 序号)打包
+inline uint64_t MakeState(uint64_t timestamp, uint64_t sequence) {
+  return timestamp << detail::kSequenceBits | sequence;
+}
+
+// Reserve的边界: 新的一毫秒、同一毫秒递增、序号溢出借用下一毫秒、时钟回拨
+void TestReserve() {
+  uint64_t first = 0;
+  
+  // 新的一毫秒从序号0开始
+  uint64_t state = detail::Reserve(0, 100, 1, &first);
+  assert(first == MakeState(100, 0));
+  assert(state == MakeState(100, 0));
+  
+  // 同一毫秒内序号递增
+  state = detail::Reserve(state, 100, 1, &first);
+  assert(first == MakeState(100, 1));
+  assert(state == MakeState(100, 1));
+  
+  // 批量预留[first, first+n)
+  state = detail::Reserve(state, 100, 10, &first);
+  assert(first == MakeState(100, 2));
+  assert(state == MakeState(100, 11));
+  
+  // 时间前进, 序号归零
+  state = detail::Reserve(MakeState(100, 5), 105, 3, &first);
+  assert(first == MakeState(105, 0));
+  assert(state == MakeState(105, 2));
+  
+  // 最后一个序号刚好用完, 不借用
+  state = detail::Reserve(MakeState(100, 4094), 100, 1, &first);
+  assert(first == MakeState(100, 4095));
+  assert(state == MakeState(100, 4095));
+  
+  // 序号溢出, 借用下一毫秒
+  state = detail::Reserve(MakeState(100, 4095), 100, 1, &first);
+  assert(first == MakeState(101, 0));
+  assert(state == MakeState(101, 0));
+  
+  // 批量放不下当前毫秒剩余的序号, 整批借用下一毫秒, 不跨毫秒拆分
+  state = detail::Reserve(MakeState(100, 4000), 100, 200, &first);
+  assert(first == MakeState(101, 0));
+  assert(state == MakeState(101, 199));
+  
+  // 一次预留一整毫秒
+  state = detail::Reserve(MakeState(100, 0), 100, kMaxBatchSize, &first);
+  assert(first == MakeState(101, 0));
+  assert(state == MakeState(101, 4095));
+  
+  // 借用以后时钟还没追上, 继续在借用的毫秒里分配
+  state = detail::Reserve(MakeState(101, 199), 100, 1, &first);
+  assert(first == MakeState(101, 200));
+  assert(state == MakeState(101, 200));
+  
+  // 时钟回拨, 沿用上次的时间, 保证单调
+  state = detail::Reserve(MakeState(100, 5), 90, 1, &first);
+  assert(first == MakeState(100, 6));
+  assert(state == MakeState(100, 6));
+  
+  // 时钟回拨并且序号溢出
+  state = detail::Reserve(MakeState(100, 4095), 90, 2, &first);
+  assert(first == MakeState(101, 0));
+  assert(state == MakeState(101, 1));
+  
+  // 连续生成的ID严格递增
+  IdWorkerUnThreadSafe id(1, 1);
+  uint64_t last = id.GetNextID();
+  for (int i=0; i<100000; ++i) {
+    uint64_t v = (i % 7 == 0) ? id.GetNextIDs(64) : id.GetNextID();
+    assert(v > last);
+    last = (i % 7 == 0) ? v + 63 : v;
+  }
+  
+  std::cout << "TestReserve> ok" << std::endl;
+}
+
+// 多线程并发生成, 每个线程执行c次GetNextIDs(batch)
+// ids不为空时保存所有ID, 用来检查重复
+void RunThreads(IdWorkerThreadSafe* id, int threads, int c, uint32_t batch, std::vector<std::vector<uint64_t>>* ids) {
+  std::vector<std::thread> workers;
+  for (int t=0; t<threads; ++t) {
+    workers.emplace_back([id, t, c, batch, ids]() {
+      for (int i=0; i<c; ++i) {
+        uint64_t v = id->GetNextIDs(batch);
+        if (ids) {
+          for (uint32_t j=0; j<batch; ++j) {
+            (*ids)[t].push_back(v + j);
+          }
+        }
+      }
+    });
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
 int main(int argc, char* argv[]) {
+  TestReserve();
+  
   IdWorkerUnThreadSafe id(0, 0);
   IdWorkerThreadSafe id2(0, 0);
   
@@ -41,28 +156,46 @@ int main(int argc, char* argv[]) {
       c = c2;
     }
   }
+  int threads = std::max(1U, std::thread::hardware_concurrency());
+  if (argc > 2) {
+    int t2 = atoi(argv[2]);
+    if (t2 > 0) {
+      threads = t2;
+    }
+  }
+  
   uint64_t b = GetNowInMsec();
-  // std::cout << "R"
-  // std::cout << GetNowInMsec() <
   for (int i=0; i<c; ++i)
-    id2.GetNextID();
-  
-  uint64_t d = GetNowInMsec() - b;
-  std::cout << "IdWorkerUnThreadSafe> Executed: " << c << std::endl;
-  std::cout << "IdWorkerUnThreadSafe> duration: " << (uint32_t)d << std::endl;
-  std::cout << "IdWorkerUnThreadSafe> avg: " << (uint32_t) (((float)c/d)*1000) << std::endl;
+    id.GetNextID();
+  PrintResult("IdWorkerUnThreadSafe", c, GetNowInMsec() - b);
 
   b = GetNowInMsec();
-  // std::cout << "R"
-  // std::cout << GetNowInMsec() <
   for (int i=0; i<c; ++i)
     id2.GetNextID();
+  PrintResult("IdWorkerThreadSafe", c, GetNowInMsec() - b);
+  
+  // 多线程
+  std::cout << "threads: " << threads << std::endl;
+  b = GetNowInMsec();
+  RunThreads(&id2, threads, c, 1, nullptr);
+  PrintResult("IdWorkerThreadSafe(mt)", (uint64_t)c * threads, GetNowInMsec() - b);
   
-  d = GetNowInMsec() - b;
-  std::cout << "IdWorkerThreadSafe> Executed: " << c << std::endl;
-  std::cout << "IdWorkerThreadSafe> duration: " << (uint32_t)d << std::endl;
-  std::cout << "IdWorkerThreadSafe> avg: " << (uint32_t) (((float)c/d)*1000) << std::endl;
+  b = GetNowInMsec();
+  RunThreads(&id2, threads, c / 64, 64, nullptr);
+  PrintResult("IdWorkerThreadSafe(mt, batch 64)", (uint64_t)(c / 64) * 64 * threads, GetNowInMsec() - b);
+  
+  // 检查多线程下ID不重复
+  int check_count = std::min(c, 100000);
+  std::vector<std::vector<uint64_t>> ids(threads);
+  RunThreads(&id2, threads, check_count, 3, &ids);
+  std::vector<uint64_t> all_ids;
+  for (auto& v : ids) {
+    all_ids.insert(all_ids.end(), v.begin(), v.end());
+  }
+  std::sort(all_ids.begin(), all_ids.end());
+  bool unique = std::adjacent_find(all_ids.begin(), all_ids.end()) == all_ids.end();
+  std::cout << "IdWorkerThreadSafe(mt)> unique check: " << all_ids.size()
+            << (unique ? " ids, ok" : " ids, DUPLICATED") << std::endl;
 
-  return 0;
+  return unique ? 0 : 1;
 }
-
@@ -0,0 +1,286 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/base/backend_health.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <folly/Format.h>
+#include <folly/Random.h>
+#include <glog/logging.h>
+
+namespace nebula {
+
+namespace {
+  
+inline int64_t NowInMsec() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+bool BackendHealthOption::SetConf(const folly::dynamic& conf) {
+  if (!conf.isObject()) {
+    return false;
+  }
+  
+  auto v = conf.getDefault("consecutive_errors");
+  if (v.isInt()) consecutive_errors = static_cast<uint32_t>(v.asInt());
+  v = conf.getDefault("error_rate");
+  if (v.isNumber()) error_rate = v.asDouble();
+  v = conf.getDefault("min_requests");
+  if (v.isInt()) min_requests = static_cast<uint32_t>(v.asInt());
+  v = conf.getDefault("latency_factor");
+  if (v.isNumber()) latency_factor = v.asDouble();
+  v = conf.getDefault("interval_ms");
+  if (v.isInt()) interval_ms = static_cast<uint32_t>(v.asInt());
+  v = conf.getDefault("base_ejection_ms");
+  if (v.isInt()) base_ejection_ms = static_cast<uint32_t>(v.asInt());
+  v = conf.getDefault("max_ejection_ms");
+  if (v.isInt()) max_ejection_ms = static_cast<uint32_t>(v.asInt());
+  v = conf.getDefault("max_ejection_percent");
+  if (v.isNumber()) max_ejection_percent = v.asDouble();
+  
+  return true;
+}
+
+std::string BackendHealthOption::ToString() const {
+  return folly::sformat("{{consecutive_errors: {}, error_rate: {}, min_requests: {}, latency_factor: {}, "
+                        "interval_ms: {}, base_ejection_ms: {}, max_ejection_ms: {}, max_ejection_percent: {}}}",
+                        consecutive_errors,
+                        error_rate,
+                        min_requests,
+                        latency_factor,
+                        interval_ms,
+                        base_ejection_ms,
+                        max_ejection_ms,
+                        max_ejection_percent);
+}
+
+const char* ToString(EjectReason reason) {
+  const char* s = "UNKNOWN";
+  
+  switch(reason) {
+    case EjectReason::CONSECUTIVE_ERRORS:
+      s = "CONSECUTIVE_ERRORS";
+      break;
+    case EjectReason::ERROR_RATE:
+      s = "ERROR_RATE";
+      break;
+    case EjectReason::LATENCY:
+      s = "LATENCY";
+      break;
+    default:
+      break;
+  }
+  
+  return s;
+}
+
+std::string BackendHealthStats::ToString() const {
+  return folly::sformat("{{conn_id: {}, ejected: {}, recovering: {}, ejection_times: {}, "
+                        "consecutive_errors: {}, error_rate: {}, latency: {}}}",
+                        conn_id,
+                        ejected,
+                        recovering,
+                        ejection_times,
+                        ejections[static_cast<int>(EjectReason::CONSECUTIVE_ERRORS)],
+                        ejections[static_cast<int>(EjectReason::ERROR_RATE)],
+                        ejections[static_cast<int>(EjectReason::LATENCY)]);
+}
+
+void BackendHealthTracker::OnConnected(uint64_t conn_id) {
+  auto backend = std::make_shared<Backend>();
+  backend->conn_id = conn_id;
+  
+  folly::SharedMutex::WriteHolder g(backends_lock_);
+  backends_[conn_id] = backend;
+}
+
+void BackendHealthTracker::OnClosed(uint64_t conn_id) {
+  folly::SharedMutex::WriteHolder g(backends_lock_);
+  backends_.erase(conn_id);
+}
+
+BackendHealthTracker::BackendPtr BackendHealthTracker::Find(uint64_t conn_id) const {
+  folly::SharedMutex::ReadHolder g(backends_lock_);
+  auto it = backends_.find(conn_id);
+  return it == backends_.end() ? nullptr : it->second;
+}
+
+void BackendHealthTracker::OnResult(uint64_t conn_id, bool success, uint64_t latency_us) {
+  auto backend = Find(conn_id);
+  if (!backend) {
+    return;
+  }
+  
+  backend->requests.fetch_add(1, std::memory_order_relaxed);
+  backend->latency_sum.fetch_add(latency_us, std::memory_order_relaxed);
+  
+  auto now = NowInMsec();
+  if (success) {
+    backend->consecutive_errors.store(0, std::memory_order_relaxed);
+  } else {
+    backend->errors.fetch_add(1, std::memory_order_relaxed);
+    auto errors = backend->consecutive_errors.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (option_.consecutive_errors > 0 && errors >= option_.consecutive_errors) {
+      backend->consecutive_errors.store(0, std::memory_order_relaxed);
+      
+      std::lock_guard<std::mutex> g(eject_mutex_);
+      folly::SharedMutex::ReadHolder g2(backends_lock_);
+      if (backend->ejected_until.load() <= now && CanEject()) {
+        Eject(backend.get(), EjectReason::CONSECUTIVE_ERRORS, now);
+      }
+    }
+  }
+  
+  // 只有一个线程做周期统计
+  auto next = next_evaluate_time_.load(std::memory_order_relaxed);
+  if (now >= next &&
+      next_evaluate_time_.compare_exchange_strong(next, now + option_.interval_ms)) {
+    Evaluate(now);
+  }
+}
+
+bool BackendHealthTracker::IsAvailable(uint64_t conn_id) const {
+  auto backend = Find(conn_id);
+  if (!backend) {
+    return true;
+  }
+  
+  auto now = NowInMsec();
+  auto ejected_until = backend->ejected_until.load(std::memory_order_relaxed);
+  if (now < ejected_until) {
+    return false;
+  }
+  
+  // 恢复期内按比例放行
+  auto recover_until = backend->recover_until.load(std::memory_order_relaxed);
+  if (now < recover_until) {
+    double ratio = static_cast<double>(now - ejected_until) / (recover_until - ejected_until);
+    return folly::Random::randDouble01() < std::max(ratio, 0.1);
+  }
+  
+  return true;
+}
+
+void BackendHealthTracker::GetStats(std::vector<BackendHealthStats>* stats) const {
+  auto now = NowInMsec();
+  
+  folly::SharedMutex::ReadHolder g(backends_lock_);
+  stats->clear();
+  for (auto& kv : backends_) {
+    auto& b = *kv.second;
+    BackendHealthStats s;
+    s.conn_id = b.conn_id;
+    s.ejected = now < b.ejected_until.load();
+    s.recovering = !s.ejected && now < b.recover_until.load();
+    s.ejection_times = b.ejection_times.load();
+    for (int i = 0; i < static_cast<int>(EjectReason::MAX); ++i) {
+      s.ejections[i] = b.ejections[i].load();
+    }
+    stats->push_back(s);
+  }
+}
+
+bool BackendHealthTracker::CanEject() const {
+  auto now = NowInMsec();
+  size_t ejected = 0;
+  for (auto& kv : backends_) {
+    if (now < kv.second->ejected_until.load(std::memory_order_relaxed)) {
+      ++ejected;
+    }
+  }
+  return ejected + 1 <= backends_.size() * option_.max_ejection_percent;
+}
+
+void BackendHealthTracker::Eject(Backend* backend, EjectReason reason, int64_t now) {
+  // 每次摘除时长翻倍
+  auto times = backend->ejection_times.fetch_add(1);
+  int64_t duration = std::min<int64_t>(static_cast<int64_t>(option_.base_ejection_ms) << std::min(times, 16u),
+                                       option_.max_ejection_ms);
+  backend->ejected_until.store(now + duration);
+  backend->recover_until.store(now + duration * 2);
+  backend->ejections[static_cast<int>(reason)].fetch_add(1);
+  
+  LOG(WARNING) << "Eject - conn_id: " << backend->conn_id
+                << ", reason: " << ToString(reason)
+                << ", duration: " << duration << "ms";
+}
+
+void BackendHealthTracker::Evaluate(int64_t now) {
+  std::lock_guard<std::mutex> g(eject_mutex_);
+  folly::SharedMutex::ReadHolder g2(backends_lock_);
+  
+  struct Sample {
+    Backend* backend;
+    double error_rate;
+    double latency;
+  };
+  std::vector<Sample> samples;
+  
+  for (auto& kv : backends_) {
+    auto& b = *kv.second;
+    auto requests = b.requests.exchange(0);
+    auto errors = b.errors.exchange(0);
+    auto latency_sum = b.latency_sum.exchange(0);
+    
+    if (now < b.ejected_until.load()) {
+      continue;
+    }
+    // 一个周期内没有失败, 退避次数衰减
+    if (errors == 0 && requests > 0 && b.ejection_times.load() > 0 && now >= b.recover_until.load()) {
+      b.ejection_times.fetch_sub(1);
+    }
+    if (requests >= option_.min_requests && requests > 0) {
+      samples.push_back(Sample{&b,
+                               static_cast<double>(errors) / requests,
+                               static_cast<double>(latency_sum) / requests});
+    }
+  }
+  
+  if (option_.error_rate > 0) {
+    for (auto& v : samples) {
+      if (v.error_rate >= option_.error_rate && CanEject()) {
+        Eject(v.backend, EjectReason::ERROR_RATE, now);
+      }
+    }
+  }
+  
+  // 至少3个后端才能比较延时
+  if (option_.latency_factor > 0 && samples.size() >= 3) {
+    std::vector<double> latencies;
+    for (auto& v : samples) {
+      latencies.push_back(v.latency);
+    }
+    std::nth_element(latencies.begin(), latencies.begin() + latencies.size() / 2, latencies.end());
+    auto median = latencies[latencies.size() / 2];
+    
+    for (auto& v : samples) {
+      if (median > 0 &&
+          v.latency > median * option_.latency_factor &&
+          now >= v.backend->ejected_until.load() &&
+          CanEject()) {
+        Eject(v.backend, EjectReason::LATENCY, now);
+      }
+    }
+  }
+}
+
+}
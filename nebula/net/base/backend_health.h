@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_BASE_BACKEND_HEALTH_H_
+#define NEBULA_NET_BASE_BACKEND_HEALTH_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/SharedMutex.h>
+#include <folly/dynamic.h>
+
+namespace nebula {
+
+// 异常后端摘除配置
+// 配置格式:
+//  "outlier" : {
+//    "consecutive_errors" : 5,       // 连续失败次数, 0为不检查
+//    "error_rate" : 0.5,             // 统计周期内失败率, 0为不检查
+//    "min_requests" : 20,            // 统计周期内请求数达到才检查失败率和延时
+//    "latency_factor" : 3.0,         // 平均延时超过同组中位数的倍数, 0为不检查
+//    "interval_ms" : 1000,           // 统计周期
+//    "base_ejection_ms" : 1000,      // 第一次摘除时长, 之后每次翻倍
+//    "max_ejection_ms" : 30000,
+//    "max_ejection_percent" : 0.5    // 同时摘除的后端比例上限
+//  }
+struct BackendHealthOption {
+  bool SetConf(const folly::dynamic& conf);
+  std::string ToString() const;
+  
+  uint32_t consecutive_errors {5};
+  double error_rate {0.5};
+  uint32_t min_requests {20};
+  double latency_factor {3.0};
+  uint32_t interval_ms {1000};
+  uint32_t base_ejection_ms {1000};
+  uint32_t max_ejection_ms {30000};
+  double max_ejection_percent {0.5};
+};
+
+enum class EjectReason : int {
+  CONSECUTIVE_ERRORS = 0,
+  ERROR_RATE = 1,
+  LATENCY = 2,
+  MAX = 3,
+};
+
+const char* ToString(EjectReason reason);
+
+struct BackendHealthStats {
+  std::string ToString() const;
+  
+  uint64_t conn_id {0};
+  bool ejected {false};
+  // 恢复期(按比例放量)
+  bool recovering {false};
+  uint32_t ejection_times {0};
+  uint64_t ejections[static_cast<int>(EjectReason::MAX)] {0};
+};
+
+// 同组后端的健康状态
+// 信号: 连续失败、统计周期内的失败率、相对同组的延时
+// 摘除一段时间(指数退避)后进入恢复期, 恢复期内放行比例从0线性增长到100%
+// OnResult/IsAvailable可以在任意线程里调用
+//  每个后端的统计都是原子变量, 查找后端只加读锁, 连接建立/关闭才加写锁
+//  摘除决策(CanEject/Eject/Evaluate)另用eject_mutex_串行
+class BackendHealthTracker {
+public:
+  explicit BackendHealthTracker(const BackendHealthOption& option)
+    : option_(option) {}
+  
+  void OnConnected(uint64_t conn_id);
+  void OnClosed(uint64_t conn_id);
+  
+  // success: 后端是否正常应答(过载拒绝等不算失败, 不需要上报)
+  void OnResult(uint64_t conn_id, bool success, uint64_t latency_us);
+  
+  bool IsAvailable(uint64_t conn_id) const;
+  
+  void GetStats(std::vector<BackendHealthStats>* stats) const;
+  
+private:
+  struct Backend {
+    uint64_t conn_id {0};
+    std::atomic<uint32_t> consecutive_errors {0};
+    // 统计周期内
+    std::atomic<uint32_t> requests {0};
+    std::atomic<uint32_t> errors {0};
+    std::atomic<uint64_t> latency_sum {0};
+    // 摘除到期时间和恢复期结束时间(毫秒)
+    std::atomic<int64_t> ejected_until {0};
+    std::atomic<int64_t> recover_until {0};
+    std::atomic<uint32_t> ejection_times {0};
+    std::atomic<uint64_t> ejections[static_cast<int>(EjectReason::MAX)];
+    
+    Backend() {
+      for (auto& v : ejections) v.store(0);
+    }
+  };
+  
+  using BackendPtr = std::shared_ptr<Backend>;
+  
+  BackendPtr Find(uint64_t conn_id) const;
+  // 需要持有eject_mutex_和backends_lock_读锁
+  bool CanEject() const;
+  void Eject(Backend* backend, EjectReason reason, int64_t now);
+  void Evaluate(int64_t now);
+  
+  BackendHealthOption option_;
+  
+  mutable folly::SharedMutex backends_lock_;
+  std::unordered_map<uint64_t, BackendPtr> backends_;
+  std::mutex eject_mutex_;
+  std::atomic<int64_t> next_evaluate_time_ {0};
+};
+
+}
+
+#endif
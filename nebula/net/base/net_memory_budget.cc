@@ -0,0 +1,55 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/base/net_memory_budget.h"
+
+#include <glog/logging.h>
+
+namespace nebula {
+
+NetMemoryBudget& NetMemoryBudget::GetInstance() {
+  static NetMemoryBudget g_budget;
+  return g_budget;
+}
+
+void NetMemoryBudget::Init(size_t budget, bool shed) {
+  budget_ = budget;
+  shed_ = shed;
+  if (enabled()) {
+    LOG(INFO) << "NetMemoryBudget - budget: " << budget_ << ", shed: " << shed_;
+  }
+}
+
+NetMemoryAccount* NetMemoryBudget::GetAccount(const std::string& service_name) {
+  std::lock_guard<std::mutex> g(lock_);
+  auto& account = accounts_[service_name];
+  if (!account) {
+    account.reset(new NetMemoryAccount(service_name));
+  }
+  return account.get();
+}
+
+std::vector<std::pair<std::string, int64_t>> NetMemoryBudget::GetServiceBytes() const {
+  std::vector<std::pair<std::string, int64_t>> v;
+  std::lock_guard<std::mutex> g(lock_);
+  for (auto& kv : accounts_) {
+    v.push_back(std::make_pair(kv.first, kv.second->bytes.load(std::memory_order_relaxed)));
+  }
+  return v;
+}
+
+}
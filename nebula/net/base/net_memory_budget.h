@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_BASE_NET_MEMORY_BUDGET_H_
+#define NEBULA_NET_BASE_NET_MEMORY_BUDGET_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nebula {
+
+// 按服务统计的网络缓冲字节数
+struct NetMemoryAccount {
+  explicit NetMemoryAccount(const std::string& service_name)
+    : name(service_name) {}
+  
+  std::string name;
+  std::atomic<int64_t> bytes {0};
+};
+
+// 进程级网络缓冲预算
+// 统计所有连接读缓冲(未解出完整包的数据)和待发送数据
+// 超出预算后由各IO线程暂停(或关闭)本线程里占用最多的连接, 回落到预算的90%以下恢复
+// 由ConnFlowControlHandler上报和执行, 见conn_flow_control_handler.h
+class NetMemoryBudget {
+public:
+  static NetMemoryBudget& GetInstance();
+  
+  // budget为0不启用; shed为true时关闭连接, 否则暂停读
+  // 须在服务启动前调用
+  void Init(size_t budget, bool shed);
+  
+  inline bool enabled() const {
+    return budget_ > 0;
+  }
+  inline bool shed() const {
+    return shed_;
+  }
+  inline size_t budget() const {
+    return budget_;
+  }
+  inline size_t resume_mark() const {
+    return budget_ / 10 * 9;
+  }
+  
+  // 返回的指针在进程内一直有效
+  NetMemoryAccount* GetAccount(const std::string& service_name);
+  
+  inline void Add(NetMemoryAccount* account, int64_t delta) {
+    account->bytes.fetch_add(delta, std::memory_order_relaxed);
+    total_bytes_.fetch_add(delta, std::memory_order_relaxed);
+  }
+  
+  inline int64_t GetTotalBytes() const {
+    return total_bytes_.load(std::memory_order_relaxed);
+  }
+  
+  inline bool IsOverBudget() const {
+    return enabled() && GetTotalBytes() > static_cast<int64_t>(budget_);
+  }
+  
+  // 各服务当前占用的字节数
+  std::vector<std::pair<std::string, int64_t>> GetServiceBytes() const;
+  
+private:
+  NetMemoryBudget() = default;
+  
+  size_t budget_ {0};
+  bool shed_ {false};
+  std::atomic<int64_t> total_bytes_ {0};
+  
+  mutable std::mutex lock_;
+  std::unordered_map<std::string, std::unique_ptr<NetMemoryAccount>> accounts_;
+};
+
+}
+
+#endif
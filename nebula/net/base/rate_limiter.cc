@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/base/rate_limiter.h"
+
+#include <chrono>
+#include <cmath>
+
+#include <folly/Conv.h>
+#include <folly/Format.h>
+#include <folly/Hash.h>
+#include <glog/logging.h>
+
+namespace nebula {
+
+namespace {
+  
+bool ParseRule(const folly::dynamic& conf, RateLimitRule* rule) {
+  if (!conf.isObject()) {
+    return false;
+  }
+
+  auto v = conf.getDefault("qps");
+  if (v.isNumber()) rule->qps = v.asDouble();
+  v = conf.getDefault("burst");
+  if (v.isNumber()) rule->burst = v.asDouble();
+  
+  if (rule->qps < 0) rule->qps = 0;
+  // 桶容量至少为1, 否则永远取不到令牌
+  if (rule->burst < 1) rule->burst = std::max(rule->qps, 1.0);
+  return true;
+}
+
+inline uint64_t NowInUsec() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+bool RateLimitConfig::SetConf(const folly::dynamic& conf) {
+  if (!conf.isObject()) {
+    return false;
+  }
+  
+  auto v = conf.getDefault("key");
+  if (v.isString()) {
+    auto key = v.asString();
+    if (key == "auth_id") {
+      key_type = RateLimitKeyType::AUTH_ID;
+    } else if (key == "conn_id") {
+      key_type = RateLimitKeyType::CONN_ID;
+    } else if (key == "remote_address") {
+      key_type = RateLimitKeyType::REMOTE_ADDRESS;
+    } else {
+      LOG(ERROR) << "SetConf - invalid rate_limit key: " << key;
+    }
+  }
+  
+  ParseRule(conf, &default_rule);
+  
+  v = conf.getDefault("methods");
+  if (v.isObject()) {
+    for (auto& kv : v.items()) {
+      RateLimitRule rule;
+      try {
+        auto method_id = folly::to<int32_t>(kv.first.asString());
+        if (ParseRule(kv.second, &rule)) {
+          method_rules[method_id] = rule;
+        }
+      } catch (...) {
+        LOG(ERROR) << "SetConf - invalid rate_limit method: " << kv.first.asString();
+      }
+    }
+  }
+  
+  return true;
+}
+
+std::string RateLimitConfig::ToString() const {
+  return folly::sformat("{{key: {}, qps: {}, burst: {}, methods: {}}}",
+                        static_cast<int>(key_type),
+                        default_rule.qps,
+                        default_rule.burst,
+                        method_rules.size());
+}
+
+TokenBucketRateLimiter::TokenBucketRateLimiter(const RateLimitConfig& config)
+  : config_(config),
+    shards_(new Shard[kShardCount]) {
+  
+  auto update_refill = [this](const RateLimitRule& rule) {
+    if (rule.enabled()) {
+      auto us = static_cast<uint64_t>(rule.burst / rule.qps * 1000000);
+      max_refill_us_ = std::max(max_refill_us_, us);
+    }
+  };
+  
+  update_refill(config_.default_rule);
+  for (auto& kv : config_.method_rules) {
+    update_refill(kv.second);
+  }
+}
+
+bool TokenBucketRateLimiter::Acquire(uint64_t key, int32_t method_id, int32_t* delay) {
+  // 单独配置的方法使用自己的桶, 其余方法共用默认桶
+  const RateLimitRule* rule = &config_.default_rule;
+  uint64_t bucket_key = key;
+  
+  auto it = config_.method_rules.find(method_id);
+  if (it != config_.method_rules.end()) {
+    rule = &it->second;
+    bucket_key = folly::hash::hash_128_to_64(key, static_cast<uint64_t>(method_id));
+  }
+  
+  if (!rule->enabled()) {
+    return true;
+  }
+  
+  return AcquireBucket(bucket_key, *rule, NowInUsec(), delay);
+}
+
+bool TokenBucketRateLimiter::AcquireBucket(uint64_t bucket_key,
+                                           const RateLimitRule& rule,
+                                           uint64_t now_us,
+                                           int32_t* delay) {
+  auto& shard = shards_[folly::hash::twang_mix64(bucket_key) % kShardCount];
+  
+  folly::SpinLockGuard g(shard.lock);
+  
+  auto it = shard.buckets.find(bucket_key);
+  if (it == shard.buckets.end()) {
+    if (shard.buckets.size() >= kMaxBucketsPerShard) {
+      EvictIdleBuckets(shard, now_us);
+      if (shard.buckets.size() >= kMaxBucketsPerShard) {
+        // 桶数已满且无可淘汰的桶, 放行而不是误杀
+        LOG_EVERY_N(WARNING, 1000) << "AcquireBucket - rate limiter shard full";
+        return true;
+      }
+    }
+    
+    // 新桶视为蓄满
+    it = shard.buckets.emplace(bucket_key, Bucket{rule.burst, now_us}).first;
+  }
+  
+  auto& bucket = it->second;
+  if (now_us > bucket.last_time_us) {
+    bucket.tokens = std::min(rule.burst,
+                             bucket.tokens + (now_us - bucket.last_time_us) * rule.qps / 1000000);
+    bucket.last_time_us = now_us;
+  }
+  
+  if (bucket.tokens >= 1) {
+    bucket.tokens -= 1;
+    return true;
+  }
+  
+  if (delay) {
+    *delay = std::max(1, static_cast<int32_t>(std::ceil((1 - bucket.tokens) / rule.qps)));
+  }
+  return false;
+}
+
+void TokenBucketRateLimiter::EvictIdleBuckets(Shard& shard, uint64_t now_us) {
+  if (now_us < shard.next_evict_us) {
+    return;
+  }
+  shard.next_evict_us = now_us + 1000000;
+  
+  for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+    if (now_us - it->second.last_time_us >= max_refill_us_) {
+      it = shard.buckets.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}
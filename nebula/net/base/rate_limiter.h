@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_BASE_RATE_LIMITER_H_
+#define NEBULA_NET_BASE_RATE_LIMITER_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <folly/SpinLock.h>
+#include <folly/dynamic.h>
+
+namespace nebula {
+
+// 限流维度
+enum class RateLimitKeyType : int {
+  AUTH_ID = 0,        // 认证后绑定到连接上的auth_id(见BindAuth), 认证前按对端地址
+  CONN_ID = 1,
+  REMOTE_ADDRESS = 2,
+};
+
+struct RateLimitRule {
+  double qps {0};     // 每秒令牌数, 0为不限流
+  double burst {0};   // 桶容量, 未设置则取qps
+  
+  inline bool enabled() const {
+    return qps > 0;
+  }
+};
+
+// 配置格式:
+//  "rate_limit" : {
+//    "key" : "auth_id",          // auth_id/conn_id/remote_address
+//    "qps" : 100,
+//    "burst" : 200,
+//    "methods" : {               // 按方法单独设置, 与默认规则各自计数
+//      "1001" : { "qps" : 10, "burst" : 20 }
+//    }
+//  }
+struct RateLimitConfig {
+  bool SetConf(const folly::dynamic& conf);
+  std::string ToString() const;
+  
+  bool enabled() const {
+    return default_rule.enabled() || !method_rules.empty();
+  }
+  
+  RateLimitKeyType key_type {RateLimitKeyType::AUTH_ID};
+  RateLimitRule default_rule;
+  std::unordered_map<int32_t, RateLimitRule> method_rules;
+};
+
+// 分片令牌桶
+// 按key哈希到分片, 每个分片一把自旋锁, 每次请求O(1)
+// 每个分片桶数有上限, 超出时淘汰已蓄满(等价于不存在)的桶
+class TokenBucketRateLimiter {
+public:
+  explicit TokenBucketRateLimiter(const RateLimitConfig& config);
+  
+  RateLimitKeyType GetKeyType() const {
+    return config_.key_type;
+  }
+  
+  // 取一个令牌, 成功返回true
+  // 失败时delay为建议客户端等待的秒数
+  bool Acquire(uint64_t key, int32_t method_id, int32_t* delay);
+  
+private:
+  enum {
+    kShardCount = 64,
+    kMaxBucketsPerShard = 8192,
+  };
+  
+  struct Bucket {
+    double tokens {0};
+    uint64_t last_time_us {0};
+  };
+  
+  struct alignas(64) Shard {
+    folly::SpinLock lock;
+    std::unordered_map<uint64_t, Bucket> buckets;
+    // 限制淘汰扫描频率, 保证均摊O(1)
+    uint64_t next_evict_us {0};
+  };
+  
+  bool AcquireBucket(uint64_t bucket_key, const RateLimitRule& rule, uint64_t now_us, int32_t* delay);
+  void EvictIdleBuckets(Shard& shard, uint64_t now_us);
+  
+  RateLimitConfig config_;
+  // 蓄满一个桶所需的最长时间, 超过该时间未访问的桶可淘汰
+  uint64_t max_refill_us_ {0};
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}
+
+#endif
@@ -35,9 +35,46 @@ bool ServiceConfig::SetConf(const std::string& conf_name, const Configuration& c
   if (v.isString()) hosts = v.asString();
   v = conf.GetValue("port");
   if (v.isInt()) port = static_cast<uint32_t>(v.asInt());
+  v = conf.GetValue("unix_path");
+  if (v.isString()) unix_path = v.asString();
+  v = conf.GetValue("prefer_unix");
+  if (v.isBool()) prefer_unix = v.asBool();
   
   v = conf.GetValue("max_conn_cnt");
   if (v.isInt()) max_conn_cnt = static_cast<uint32_t>(v.asInt());
+  v = conf.GetValue("idle_timeout");
+  if (v.isInt()) idle_timeout = static_cast<uint32_t>(v.asInt());
+  v = conf.GetValue("reuse_port");
+  if (v.isBool()) reuse_port = v.asBool();
+  
+  v = conf.GetValue("write_high_watermark");
+  if (v.isInt()) write_high_watermark = static_cast<uint32_t>(v.asInt());
+  v = conf.GetValue("write_low_watermark");
+  if (v.isInt()) write_low_watermark = static_cast<uint32_t>(v.asInt());
+  if (write_low_watermark == 0 || write_low_watermark > write_high_watermark) {
+    write_low_watermark = write_high_watermark / 2;
+  }
+  v = conf.GetValue("write_overflow_policy");
+  if (v.isString()) {
+    if (v.asString() == "close") {
+      write_overflow_policy = WriteOverflowPolicy::CLOSE;
+    } else {
+      write_overflow_policy = WriteOverflowPolicy::PAUSE_READ;
+    }
+  }
+  
+  v = conf.GetValue("batch_max_count");
+  if (v.isInt()) batch_max_count = static_cast<uint32_t>(v.asInt());
+  v = conf.GetValue("batch_window_ms");
+  if (v.isInt()) batch_window_ms = static_cast<uint32_t>(v.asInt());
+  
+  v = conf.GetValue("local_call");
+  if (v.isBool()) local_call = v.asBool();
+  
+  v = conf.GetValue("rate_limit");
+  if (v.isObject()) rate_limit.SetConf(v);
+  v = conf.GetValue("outlier");
+  if (v.isObject()) outlier.SetConf(v);
   
   return true;
 }
@@ -58,6 +95,8 @@ void ServiceConfig::PrintDebug() const {
             << ", hosts: " << hosts
             << ", port: " << port
             << ", max_conn_cnt: " << max_conn_cnt
+            << ", idle_timeout: " << idle_timeout
+            << ", rate_limit: " << rate_limit.ToString()
             << std::endl;
 }
 
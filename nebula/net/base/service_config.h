@@ -20,9 +20,17 @@
 
 #include "nebula/base/configurable.h"
 #include "nebula/base/configuration.h"
+#include "nebula/net/base/backend_health.h"
+#include "nebula/net/base/rate_limiter.h"
 
 namespace nebula {
   
+// 连接待发送数据超过write_high_watermark时的处理方式
+enum class WriteOverflowPolicy : int {
+  PAUSE_READ = 0,     // 暂停读, 对端收不到应答自然会停止发送
+  CLOSE = 1,          // 关闭连接
+};
+
 struct ServiceConfig : public Configurable {
   virtual ~ServiceConfig() = default;
   
@@ -38,9 +46,48 @@ struct ServiceConfig : public Configurable {
   std::string hosts;  // 主机地址（单台机器使用的多个IP采用‘,’分割）
   uint32_t    port;   // 端口号
   
+  // unix domain socket路径
+  //  1. 服务端配置后除了port以外同时监听这个路径, hosts也可以直接配成"unix:路径"
+  //  2. 客户端配置prefer_unix后, 后端在本机且路径存在时优先走unix domain socket
+  std::string unix_path;
+  bool prefer_unix {false};
+  
   // 1. 对于tcp_server/http_server为最大连接数，未设置默认为40960
   // 2. 对于tcp_client为连接池大小，未设置默认为1
   uint32_t max_conn_cnt {40960};
+  
+  // tcp_server: 空闲连接超时(毫秒), 超过这个时间没收到任何数据则关闭连接
+  //  实际关闭在idle_timeout到2*idle_timeout之间, 0为不检查
+  //  rpc_server不检查: rpc_client不发心跳, 空闲的内网链路不能被踢掉
+  uint32_t idle_timeout {240000};
+  
+  // tcp_server: 每个IO线程一个SO_REUSEPORT监听socket, 各线程只accept自己的连接
+  //  平滑重启时不能修改, 需要停掉旧进程后重启
+  bool reuse_port {false};
+  
+  // 连接写缓冲水位(字节), 对端不读数据时防止写缓冲无限增长
+  //  待发送数据超过write_high_watermark时按write_overflow_policy处理,
+  //  低于write_low_watermark时恢复, 未设置取write_high_watermark/2
+  //  write_high_watermark为0不启用
+  //  不提供丢弃数据的策略: 帧已编好frame_index, 丢掉一帧对端校验失败
+  uint32_t write_high_watermark {0};
+  uint32_t write_low_watermark {0};
+  WriteOverflowPolicy write_overflow_policy {WriteOverflowPolicy::PAUSE_READ};
+  
+  // 服务端按客户端限流, 未配置则不限流
+  RateLimitConfig rate_limit;
+  
+  // zrpc批量写: 多个请求(或应答)打包成一个Container写出, 小于2不启用
+  uint32_t batch_max_count {0};
+  // 批量等待窗口(毫秒), 0为只合并同一次事件循环里的写
+  uint32_t batch_window_ms {0};
+  
+  // tcp_client_group异常后端摘除
+  BackendHealthOption outlier;
+  
+  // zrpc客户端: 打开后方法在本进程已注册时直接调用, 不经过网络(对冲的方法除外)
+  //  请求和应答仍按网络格式编解码一次, 服务端和客户端拿到的对象和走网络时一样
+  bool local_call {false};
 };
 
 using ServiceConfigPtr = std::shared_ptr<ServiceConfig>;
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/base/socket_address_util.h"
+
+#include <ifaddrs.h>
+#include <sys/stat.h>
+
+#include <vector>
+
+#include <folly/IPAddress.h>
+#include <glog/logging.h>
+
+#include "nebula/net/base/service_config.h"
+
+namespace nebula {
+
+namespace {
+
+const char kUnixPrefix[] = "unix:";
+const size_t kUnixPrefixLen = sizeof(kUnixPrefix) - 1;
+
+// 本机网卡地址, 只在第一次用到时取一次
+const std::vector<folly::IPAddress>& GetLocalIPAddresses() {
+  static std::vector<folly::IPAddress> g_local_addresses = []() {
+    std::vector<folly::IPAddress> addresses;
+    struct ifaddrs* ifaddr = nullptr;
+    if (getifaddrs(&ifaddr) != 0) {
+      PLOG(ERROR) << "GetLocalIPAddresses - getifaddrs error";
+      return addresses;
+    }
+    
+    for (auto ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
+      if (ifa->ifa_addr == nullptr ||
+          (ifa->ifa_addr->sa_family != AF_INET && ifa->ifa_addr->sa_family != AF_INET6)) {
+        continue;
+      }
+      try {
+        addresses.push_back(folly::IPAddress(ifa->ifa_addr));
+      } catch (...) {
+      }
+    }
+    freeifaddrs(ifaddr);
+    return addresses;
+  }();
+  
+  return g_local_addresses;
+}
+
+}
+
+bool IsUnixAddress(const std::string& host) {
+  return host.compare(0, kUnixPrefixLen, kUnixPrefix) == 0;
+}
+
+std::string GetUnixPath(const std::string& host) {
+  return IsUnixAddress(host) ? host.substr(kUnixPrefixLen) : std::string();
+}
+
+folly::SocketAddress MakeSocketAddress(const std::string& host, uint16_t port) {
+  folly::SocketAddress address;
+  if (IsUnixAddress(host)) {
+    address.setFromPath(GetUnixPath(host));
+  } else {
+    address.setFromHostPort(host.c_str(), port);
+  }
+  return address;
+}
+
+std::string ToAddressString(const folly::SocketAddress& address) {
+  if (address.getFamily() == AF_UNIX) {
+    // 客户端的unix socket一般没有绑定路径, 为空
+    return kUnixPrefix + address.getPath();
+  }
+  return address.getAddressStr();
+}
+
+bool IsLocalHost(const std::string& host) {
+  if (host == "localhost") {
+    return true;
+  }
+  
+  if (!folly::IPAddress::validate(host)) {
+    return false;
+  }
+  folly::IPAddress ip(host);
+  if (ip.isLoopback()) {
+    return true;
+  }
+  
+  for (auto& local : GetLocalIPAddresses()) {
+    if (local == ip) {
+      return true;
+    }
+  }
+  return false;
+}
+
+folly::SocketAddress MakeClientAddress(const ServiceConfig& config) {
+  if (config.prefer_unix &&
+      !config.unix_path.empty() &&
+      !IsUnixAddress(config.hosts) &&
+      IsLocalHost(config.hosts)) {
+    struct stat st;
+    if (stat(config.unix_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+      LOG(INFO) << "MakeClientAddress - prefer unix socket: " << config.unix_path
+                << ", service: " << config.ToString();
+      folly::SocketAddress address;
+      address.setFromPath(config.unix_path);
+      return address;
+    }
+  }
+  
+  return MakeSocketAddress(config.hosts, static_cast<uint16_t>(config.port));
+}
+
+}
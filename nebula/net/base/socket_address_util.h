@@ -0,0 +1,48 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_BASE_SOCKET_ADDRESS_UTIL_H_
+#define NEBULA_NET_BASE_SOCKET_ADDRESS_UTIL_H_
+
+#include <string>
+
+#include <folly/SocketAddress.h>
+
+namespace nebula {
+
+struct ServiceConfig;
+
+// hosts以"unix:"开头时为unix domain socket路径, 如"unix:/var/run/nebula/biz.sock"
+bool IsUnixAddress(const std::string& host);
+std::string GetUnixPath(const std::string& host);
+
+// unix:地址生成AF_UNIX地址, 否则为ip:port
+folly::SocketAddress MakeSocketAddress(const std::string& host, uint16_t port);
+
+// 连接地址转成字符串, AF_UNIX地址调用getAddressStr会抛异常
+std::string ToAddressString(const folly::SocketAddress& address);
+
+// 回环地址或本机网卡地址
+bool IsLocalHost(const std::string& host);
+
+// 客户端连接地址
+// 配置了prefer_unix和unix_path, 后端在本机且unix_path存在时走unix domain socket
+folly::SocketAddress MakeClientAddress(const ServiceConfig& config);
+
+}
+
+#endif
@@ -0,0 +1,355 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/base/socket_handoff.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include <folly/String.h>
+#include <glog/logging.h>
+
+namespace nebula {
+
+namespace {
+
+const char kTakeoverRequest = 'T';
+const char kTakeoverAck = 'A';
+
+// 一次最多传递的fd数, 小于内核的SCM_MAX_FD(253)
+const size_t kMaxHandoffFds = 200;
+const size_t kMaxNamesSize = 64 * 1024;
+
+// 新进程确认的最长等待时间(毫秒), 超时认为接管失败, 旧进程继续服务
+const int kTakeoverAckTimeout = 60000;
+// 连上以后发送接管请求的最长等待时间(毫秒)
+const int kTakeoverRequestTimeout = 5000;
+
+bool MakeUnixAddress(const std::string& path, struct sockaddr_un* addr) {
+  if (path.size() >= sizeof(addr->sun_path)) {
+    LOG(ERROR) << "MakeUnixAddress - path too long: " << path;
+    return false;
+  }
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path.c_str(), path.size());
+  return true;
+}
+
+// 服务名以'\n'分隔放在数据里, fd放在SCM_RIGHTS里, 顺序一致
+bool SendFds(int sock, const ListenFdList& fds) {
+  if (fds.size() > kMaxHandoffFds) {
+    LOG(ERROR) << "SendFds - too many listen fds: " << fds.size();
+    return false;
+  }
+  
+  std::string names;
+  for (auto& v : fds) {
+    names.append(v.first);
+    names.push_back('\n');
+  }
+  if (names.empty()) {
+    // 至少要发一个字节
+    names.push_back('\n');
+  }
+  
+  struct iovec iov;
+  iov.iov_base = const_cast<char*>(names.data());
+  iov.iov_len = names.size();
+  
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  
+  std::vector<char> control;
+  if (!fds.empty()) {
+    control.resize(CMSG_SPACE(sizeof(int) * fds.size()));
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    int* data = reinterpret_cast<int*>(CMSG_DATA(cmsg));
+    for (size_t i = 0; i < fds.size(); ++i) {
+      data[i] = fds[i].second;
+    }
+  }
+  
+  if (sendmsg(sock, &msg, 0) != static_cast<ssize_t>(names.size())) {
+    PLOG(ERROR) << "SendFds - sendmsg error";
+    return false;
+  }
+  return true;
+}
+
+bool RecvFds(int sock, std::multimap<std::string, int>* fds) {
+  std::vector<char> names(kMaxNamesSize);
+  struct iovec iov;
+  iov.iov_base = names.data();
+  iov.iov_len = names.size();
+  
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxHandoffFds));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+  
+  auto n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  if (n <= 0) {
+    PLOG(ERROR) << "RecvFds - recvmsg error";
+    return false;
+  }
+  
+  std::vector<int> received;
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      int* data = reinterpret_cast<int*>(CMSG_DATA(cmsg));
+      received.insert(received.end(), data, data + count);
+    }
+  }
+  
+  std::vector<folly::StringPiece> parts;
+  folly::split('\n', folly::StringPiece(names.data(), n), parts, true);
+  if ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || parts.size() != received.size()) {
+    LOG(ERROR) << "RecvFds - invalid handoff message, names: " << parts.size()
+               << ", fds: " << received.size();
+    for (auto fd : received) {
+      close(fd);
+    }
+    return false;
+  }
+  
+  for (size_t i = 0; i < parts.size(); ++i) {
+    fds->insert(std::make_pair(parts[i].str(), received[i]));
+  }
+  return true;
+}
+
+}
+
+ListenSocketHandoff& ListenSocketHandoff::GetInstance() {
+  static ListenSocketHandoff g_handoff;
+  return g_handoff;
+}
+
+ListenSocketHandoff::~ListenSocketHandoff() {
+  Stop();
+}
+
+bool ListenSocketHandoff::Takeover(const std::string& path) {
+  struct sockaddr_un addr;
+  if (!MakeUnixAddress(path, &addr)) {
+    return false;
+  }
+  
+  int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock < 0) {
+    PLOG(ERROR) << "Takeover - socket error";
+    return false;
+  }
+  
+  // 旧进程不存在, 正常启动
+  if (connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    LOG(INFO) << "Takeover - no running instance on " << path;
+    close(sock);
+    return false;
+  }
+  
+  if (write(sock, &kTakeoverRequest, 1) != 1 || !RecvFds(sock, &inherited_fds_)) {
+    LOG(ERROR) << "Takeover - receive listen fds error from " << path;
+    close(sock);
+    return false;
+  }
+  
+  LOG(INFO) << "Takeover - received " << inherited_fds_.size() << " listen fds from " << path;
+  takeover_conn_ = sock;
+  return true;
+}
+
+std::vector<int> ListenSocketHandoff::TakeInheritedFds(const std::string& name) {
+  std::vector<int> fds;
+  auto range = inherited_fds_.equal_range(name);
+  for (auto it = range.first; it != range.second; ++it) {
+    fds.push_back(it->second);
+  }
+  inherited_fds_.erase(range.first, range.second);
+  return fds;
+}
+
+void ListenSocketHandoff::CompleteTakeover() {
+  // 新配置里已经没有的服务
+  for (auto& v : inherited_fds_) {
+    LOG(WARNING) << "CompleteTakeover - unused listen fd, service: " << v.first;
+    close(v.second);
+  }
+  inherited_fds_.clear();
+  
+  if (takeover_conn_ >= 0) {
+    if (write(takeover_conn_, &kTakeoverAck, 1) != 1) {
+      PLOG(ERROR) << "CompleteTakeover - ack error";
+    }
+    close(takeover_conn_);
+    takeover_conn_ = -1;
+  }
+}
+
+bool ListenSocketHandoff::Listen(const std::string& path,
+                                 std::function<ListenFdList()> get_fds,
+                                 std::function<void()> on_handoff) {
+  struct sockaddr_un addr;
+  if (!MakeUnixAddress(path, &addr)) {
+    return false;
+  }
+  
+  int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock < 0) {
+    PLOG(ERROR) << "Listen - socket error";
+    return false;
+  }
+  
+  // 旧进程的路径已经没用了, 直接替换
+  unlink(path.c_str());
+  if (bind(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(sock, 1) != 0) {
+    PLOG(ERROR) << "Listen - bind error: " << path;
+    close(sock);
+    return false;
+  }
+  
+  if (pipe2(wakeup_fds_, O_CLOEXEC) != 0) {
+    PLOG(ERROR) << "Listen - pipe error";
+    close(sock);
+    unlink(path.c_str());
+    return false;
+  }
+  
+  listen_path_ = path;
+  listen_fd_ = sock;
+  listen_thread_ = std::thread([this, get_fds, on_handoff]() {
+    ListenLoop(get_fds, on_handoff);
+  });
+  return true;
+}
+
+void ListenSocketHandoff::ListenLoop(std::function<ListenFdList()> get_fds,
+                                     std::function<void()> on_handoff) {
+  while (!stopped_.load()) {
+    if (!WaitReadable(listen_fd_, -1)) {
+      break;
+    }
+    
+    int conn = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (conn < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (!stopped_.load()) {
+        PLOG(ERROR) << "ListenLoop - accept error";
+      }
+      break;
+    }
+    
+    char request = 0;
+    if (!WaitReadable(conn, kTakeoverRequestTimeout) ||
+        read(conn, &request, 1) != 1 || request != kTakeoverRequest || !SendFds(conn, get_fds())) {
+      LOG(ERROR) << "ListenLoop - invalid takeover request";
+      close(conn);
+      continue;
+    }
+    
+    // 等新进程启动完成, 失败时继续服务
+    char ack = 0;
+    if (WaitReadable(conn, kTakeoverAckTimeout) && read(conn, &ack, 1) == 1 && ack == kTakeoverAck) {
+      close(conn);
+      LOG(INFO) << "ListenLoop - listen fds handed off, draining";
+      // 路径已经由新进程接管
+      listen_path_.clear();
+      on_handoff();
+      break;
+    }
+    
+    if (!stopped_.load()) {
+      LOG(ERROR) << "ListenLoop - takeover not completed, keep serving";
+    }
+    close(conn);
+  }
+}
+
+bool ListenSocketHandoff::WaitReadable(int fd, int timeout_ms) {
+  struct pollfd pfds[2];
+  pfds[0].fd = fd;
+  pfds[0].events = POLLIN;
+  pfds[1].fd = wakeup_fds_[0];
+  pfds[1].events = POLLIN;
+  
+  for (;;) {
+    pfds[0].revents = 0;
+    pfds[1].revents = 0;
+    int rv = poll(pfds, 2, timeout_ms);
+    if (rv < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rv < 0) {
+      PLOG(ERROR) << "WaitReadable - poll error";
+      return false;
+    }
+    return rv > 0 && pfds[1].revents == 0 && pfds[0].revents != 0;
+  }
+}
+
+void ListenSocketHandoff::Stop() {
+  if (stopped_.exchange(true)) {
+    return;
+  }
+  
+  if (wakeup_fds_[1] >= 0) {
+    // 唤醒接管线程, accept和等新进程确认都会返回
+    char c = 0;
+    if (write(wakeup_fds_[1], &c, 1) != 1) {
+      PLOG(ERROR) << "Stop - write wakeup error";
+    }
+  }
+  if (listen_thread_.joinable()) {
+    listen_thread_.join();
+  }
+  for (auto& fd : wakeup_fds_) {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+  }
+  if (!listen_path_.empty()) {
+    unlink(listen_path_.c_str());
+  }
+}
+
+}
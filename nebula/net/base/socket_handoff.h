@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_BASE_SOCKET_HANDOFF_H_
+#define NEBULA_NET_BASE_SOCKET_HANDOFF_H_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nebula {
+
+// 监听fd, name为服务名
+typedef std::vector<std::pair<std::string, int>> ListenFdList;
+
+// 平滑重启: 新进程通过unix socket从旧进程取回监听fd(SCM_RIGHTS)
+// 流程:
+//  1. 旧进程启动后在takeover_path上等待接管
+//  2. 新进程启动服务前调用Takeover, 取回旧进程所有服务的监听fd
+//  3. 新进程用继承的fd启动服务(两个进程同时accept同一个监听socket, 不丢连接),
+//     然后调用CompleteTakeover通知旧进程
+//  4. 旧进程停止accept, 给已有连接发Redirect, 在期限内等连接断开后退出
+//  5. 新进程在takeover_path上等待下一次接管
+class ListenSocketHandoff {
+public:
+  static ListenSocketHandoff& GetInstance();
+  
+  // 新进程: 连接旧进程取回监听fd, 旧进程不存在返回false
+  bool Takeover(const std::string& path);
+  
+  // 取出继承的监听fd, 同名服务有多个监听socket时按顺序返回
+  std::vector<int> TakeInheritedFds(const std::string& name);
+  
+  // 新进程: 服务已启动, 通知旧进程下线, 关闭未使用的继承fd
+  void CompleteTakeover();
+  
+  // 旧进程: 在path上等待新进程接管
+  // get_fds在接管线程里调用, on_handoff为新进程确认以后回调, 只回调一次
+  bool Listen(const std::string& path,
+              std::function<ListenFdList()> get_fds,
+              std::function<void()> on_handoff);
+  void Stop();
+  
+private:
+  ListenSocketHandoff() = default;
+  ~ListenSocketHandoff();
+  
+  void ListenLoop(std::function<ListenFdList()> get_fds, std::function<void()> on_handoff);
+  // 等fd可读, 超时或者Stop()唤醒返回false
+  bool WaitReadable(int fd, int timeout_ms);
+  
+  // 新进程到旧进程的连接, CompleteTakeover时确认
+  int takeover_conn_ {-1};
+  std::multimap<std::string, int> inherited_fds_;
+  
+  std::string listen_path_;
+  int listen_fd_ {-1};
+  // Stop()往wakeup_fds_[1]写一个字节, 唤醒接管线程里所有的等待
+  int wakeup_fds_[2] {-1, -1};
+  std::atomic<bool> stopped_ {false};
+  std::thread listen_thread_;
+};
+
+}
+
+#endif
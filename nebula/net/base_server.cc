@@ -20,8 +20,15 @@
 #include "nebula/base/config_manager.h"
 // #include "nebula/base/gperftools_profiler.h"
 
+#include <chrono>
+
 #include "nebula/net/net_engine_manager.h"
+#include "nebula/net/thread_local_conn_manager.h"
+#include "nebula/net/base/net_memory_budget.h"
+#include "nebula/net/base/socket_handoff.h"
 #include "nebula/net/handler/module_install.h"
+#include "nebula/net/handler/zproto/zproto_frame_handler.h"
+#include "nebula/net/handler/zproto/zproto_handler.h"
 
 namespace nebula {
   
@@ -49,6 +56,9 @@ bool BaseServer::Initialize() {
   BaseDaemon::Initialize();
   InstallModule();
   
+  // 须在创建连接前设置
+  NetMemoryBudget::GetInstance().Init(system_config_.net_memory_budget, system_config_.net_memory_shed);
+  
   // 初始化程序
   auto thread_groups = std::make_shared<ThreadGroupListManager>(thread_group_options_);
   auto net_engine_manager = NetEngineManager::GetInstance();
@@ -62,8 +72,24 @@ bool BaseServer::Initialize() {
   return true;
 }
 
+namespace {
+
+uint64_t NowInMsec() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
 bool BaseServer::Run() {
   auto net_engine_manager = NetEngineManager::GetInstance();
+  auto& handoff = ListenSocketHandoff::GetInstance();
+  
+  // 有旧进程在运行, 先接管它的监听socket
+  if (!system_config_.takeover_path.empty()) {
+    handoff.Takeover(system_config_.takeover_path);
+  }
+  
   // 启动成功
   try {
     net_engine_manager->Start();
@@ -75,6 +101,19 @@ bool BaseServer::Run() {
     return -1;
   }
   
+  if (!system_config_.takeover_path.empty()) {
+    handoff.CompleteTakeover();
+    handoff.Listen(system_config_.takeover_path,
+                   []() {
+                     return NetEngineManager::GetInstance()->GetListenFds();
+                   },
+                   [this]() {
+                     main_eb_.runInEventBaseThread([this]() {
+                       Drain();
+                     });
+                   });
+  }
+  
   // GPerftoolsProfiler profiler;
   // profiler.ProfilerStart();
 
@@ -82,10 +121,64 @@ bool BaseServer::Run() {
 
   // profiler.ProfilerStop();
   
+  handoff.Stop();
   net_engine_manager->Stop();
   return true;
 }
 
+void BaseServer::Drain() {
+  auto net_engine_manager = NetEngineManager::GetInstance();
+  net_engine_manager->StopAccepting();
+  
+  LOG(INFO) << "Drain - stop accepting, conns: " << net_engine_manager->GetServerConnCount()
+            << ", drain_timeout: " << system_config_.drain_timeout;
+  
+  // 通知zproto客户端重连, 未配置redirect_host则重连原地址, 由新进程接受
+  auto host = system_config_.redirect_host;
+  auto port = static_cast<int>(system_config_.redirect_port);
+  auto timeout = static_cast<int>(system_config_.redirect_timeout);
+  for (size_t i = 0; i < net_engine_manager->thread_datas_size(); ++i) {
+    auto evb = net_engine_manager->thread_datas(i).evb;
+    if (!evb) {
+      continue;
+    }
+    evb->runInEventBaseThread([host, port, timeout]() {
+      GetConnManagerByThreadLocal().ForEachPipeline([&](uint64_t conn_id, wangle::PipelineBase* pipeline) {
+        auto frame_handler = pipeline->getHandler<ZProtoFrameHandler>();
+        auto handler = pipeline->getHandler<ZProtoHandler>();
+        if (!frame_handler || !handler ||
+            handler->GetServiceBase()->GetModuleType() != ServiceModuleType::TCP_SERVER) {
+          return;
+        }
+        
+        if (!host.empty()) {
+          frame_handler->SendRedirect(host, port, timeout);
+        } else {
+          auto local = pipeline->getTransportInfo() ? pipeline->getTransportInfo()->localAddr : nullptr;
+          if (local && local->isFamilyInet()) {
+            frame_handler->SendRedirect(local->getAddressStr(), local->getPort(), timeout);
+          }
+        }
+      });
+    });
+  }
+  
+  CheckDrained(NowInMsec() + system_config_.drain_timeout);
+}
+
+void BaseServer::CheckDrained(uint64_t deadline) {
+  auto conns = NetEngineManager::GetInstance()->GetServerConnCount();
+  if (conns == 0 || NowInMsec() >= deadline) {
+    LOG(INFO) << "CheckDrained - exit, remaining conns: " << conns;
+    main_eb_.terminateLoopSoon();
+    return;
+  }
+  
+  main_eb_.runAfterDelay([this, deadline]() {
+    CheckDrained(deadline);
+  }, 100);
+}
+
 
 bool BaseServer::Destroy() {
   return BaseDaemon::Destroy();
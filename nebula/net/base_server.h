@@ -55,6 +55,11 @@ protected:
   bool Run() override;
   bool Destroy() override;
   
+  // 平滑重启, 监听socket交给新进程以后在主线程里执行
+  // 停止accept, 通知zproto客户端重连, 连接都断开或超时后退出
+  void Drain();
+  void CheckDrained(uint64_t deadline);
+  
   // 为0默认多线程模式
   size_t io_thread_pool_size_{0};
   
@@ -0,0 +1,197 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/conn_index.h"
+
+#include <folly/Hash.h>
+
+namespace nebula {
+
+ConnIndex& ConnIndex::GetInstance() {
+  static ConnIndex g_conn_index;
+  return g_conn_index;
+}
+
+void ConnIndex::Bind(uint64_t conn_id, int64_t auth_id, int64_t session_id) {
+  if (auth_id != 0) {
+    auth_index_.Add(auth_id, conn_id);
+  }
+  if (session_id != 0) {
+    session_index_.Add(session_id, conn_id);
+  }
+}
+
+void ConnIndex::Unbind(uint64_t conn_id, int64_t auth_id, int64_t session_id) {
+  if (auth_id != 0) {
+    auth_index_.Remove(auth_id, conn_id);
+  }
+  if (session_id != 0) {
+    session_index_.Remove(session_id, conn_id);
+  }
+}
+
+size_t ConnIndex::LookupByAuthID(int64_t auth_id, std::vector<uint64_t>* conn_ids) const {
+  return auth_id != 0 ? auth_index_.Lookup(auth_id, conn_ids) : 0;
+}
+
+size_t ConnIndex::LookupBySessionID(int64_t session_id, std::vector<uint64_t>* conn_ids) const {
+  return session_id != 0 ? session_index_.Lookup(session_id, conn_ids) : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+// 低位已经用来选分片了
+inline size_t HashPos(int64_t key) {
+  return static_cast<size_t>(folly::hash::twang_mix64(static_cast<uint64_t>(key)) >> 6);
+}
+
+}
+
+ConnIndex::ShardedIndex::ShardedIndex()
+  : shards_(new Shard[kShardCount]) {
+  for (int i = 0; i < kShardCount; ++i) {
+    shards_[i].tables = new Table(kInitTableSize);
+  }
+}
+
+ConnIndex::ShardedIndex::~ShardedIndex() {
+  for (int i = 0; i < kShardCount; ++i) {
+    auto table = shards_[i].tables;
+    while (table) {
+      auto next = table->next.load();
+      delete table;
+      table = next;
+    }
+  }
+}
+
+ConnIndex::ShardedIndex::Shard& ConnIndex::ShardedIndex::GetShard(int64_t key) const {
+  return shards_[folly::hash::twang_mix64(static_cast<uint64_t>(key)) % kShardCount];
+}
+
+void ConnIndex::ShardedIndex::Add(int64_t key, uint64_t conn_id) {
+  auto& shard = GetShard(key);
+  std::lock_guard<std::mutex> g(shard.lock);
+  
+  auto pos = HashPos(key);
+  for (auto table = shard.tables; table; table = table->next.load()) {
+    auto mask = table->size - 1;
+    auto max_probe = table->max_probe.load();
+    for (size_t i = 0; i <= max_probe; ++i) {
+      auto& slot = table->slots[(pos + i) & mask];
+      auto k = slot.key.load();
+      if (k == 0) {
+        break;
+      }
+      if (k == key && slot.conn_id.load() == conn_id) {
+        return;
+      }
+    }
+  }
+  
+  auto table = shard.tables;
+  for (;;) {
+    auto mask = table->size - 1;
+    for (size_t i = 0; i < table->size; ++i) {
+      auto& slot = table->slots[(pos + i) & mask];
+      auto k = slot.key.load();
+      if (k == 0) {
+        if ((table->used + 1) * 4 > table->size * 3) {
+          break;
+        }
+        ++table->used;
+      } else if (slot.conn_id.load() != 0) {
+        continue;
+      }
+      
+      if (i > table->max_probe.load()) {
+        table->max_probe.store(i);
+      }
+      auto version = slot.version.load();
+      slot.version.store(version + 1);
+      slot.key.store(key);
+      slot.conn_id.store(conn_id);
+      slot.version.store(version + 2);
+      return;
+    }
+    
+    auto next = table->next.load();
+    if (!next) {
+      next = new Table(table->size * 2);
+      table->next.store(next);
+    }
+    table = next;
+  }
+}
+
+void ConnIndex::ShardedIndex::Remove(int64_t key, uint64_t conn_id) {
+  auto& shard = GetShard(key);
+  std::lock_guard<std::mutex> g(shard.lock);
+  
+  auto pos = HashPos(key);
+  for (auto table = shard.tables; table; table = table->next.load()) {
+    auto mask = table->size - 1;
+    auto max_probe = table->max_probe.load();
+    for (size_t i = 0; i <= max_probe; ++i) {
+      auto& slot = table->slots[(pos + i) & mask];
+      auto k = slot.key.load();
+      if (k == 0) {
+        break;
+      }
+      if (k == key && slot.conn_id.load() == conn_id) {
+        auto version = slot.version.load();
+        slot.version.store(version + 1);
+        slot.conn_id.store(0);
+        slot.version.store(version + 2);
+        return;
+      }
+    }
+  }
+}
+
+size_t ConnIndex::ShardedIndex::Lookup(int64_t key, std::vector<uint64_t>* conn_ids) const {
+  auto& shard = GetShard(key);
+  
+  size_t found = 0;
+  auto pos = HashPos(key);
+  for (auto table = shard.tables; table; table = table->next.load()) {
+    auto mask = table->size - 1;
+    auto max_probe = table->max_probe.load();
+    for (size_t i = 0; i <= max_probe; ++i) {
+      auto& slot = table->slots[(pos + i) & mask];
+      auto version = slot.version.load();
+      if (version & 1) {
+        // 正在写, 这次查找和写并发, 跳过
+        continue;
+      }
+      auto k = slot.key.load();
+      if (k == 0) {
+        break;
+      }
+      auto conn_id = slot.conn_id.load();
+      if (k == key && conn_id != 0 && slot.version.load() == version) {
+        conn_ids->push_back(conn_id);
+        ++found;
+      }
+    }
+  }
+  
+  return found;
+}
+
+}
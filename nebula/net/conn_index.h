@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_CONN_INDEX_H_
+#define NEBULA_NET_CONN_INDEX_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace nebula {
+
+// auth_id/session_id到conn_id的索引, 进程内所有IO线程共用
+// 按key哈希分片, 每个分片是开放寻址的槽数组
+//  写(连接认证/关闭)只在所属IO线程里发生, 频率低, 分片内加锁
+//  读不加锁, 最多探测max_probe个槽, 推送服务可以在任意线程里查
+// 同一个key可以对应多个连接(同一用户多端登录)
+class ConnIndex {
+public:
+  static ConnIndex& GetInstance();
+  
+  // 0为无效值, 不建索引
+  void Bind(uint64_t conn_id, int64_t auth_id, int64_t session_id);
+  void Unbind(uint64_t conn_id, int64_t auth_id, int64_t session_id);
+  
+  // 追加到conn_ids, 返回找到的个数
+  size_t LookupByAuthID(int64_t auth_id, std::vector<uint64_t>* conn_ids) const;
+  size_t LookupBySessionID(int64_t session_id, std::vector<uint64_t>* conn_ids) const;
+  
+private:
+  ConnIndex() = default;
+  
+  class ShardedIndex {
+  public:
+    ShardedIndex();
+    ~ShardedIndex();
+    
+    void Add(int64_t key, uint64_t conn_id);
+    void Remove(int64_t key, uint64_t conn_id);
+    size_t Lookup(int64_t key, std::vector<uint64_t>* conn_ids) const;
+    
+  private:
+    enum {
+      kShardCount = 64,
+      kInitTableSize = 256,   // 2的幂
+    };
+    
+    // 一个槽存一对(key, conn_id), 同一个key的多个连接各占一个槽
+    //  key为0是从没用过的槽, 探测到这里结束
+    //  conn_id为0是删掉的槽, key保留, 插入时可以复用
+    // 写槽前后version各加1, 读的时候version是奇数或者前后不一致就跳过这个槽
+    struct Slot {
+      std::atomic<uint64_t> version {0};
+      std::atomic<int64_t> key {0};
+      std::atomic<uint64_t> conn_id {0};
+    };
+    
+    // 槽只复用不回收, 装满3/4后挂一张两倍大的新表
+    struct Table {
+      explicit Table(size_t n)
+        : size(n),
+          slots(new Slot[n]) {}
+      
+      const size_t size;
+      std::unique_ptr<Slot[]> slots;
+      // 插入位置离hash位置最远的距离, 读最多探测这么远
+      std::atomic<size_t> max_probe {0};
+      std::atomic<Table*> next {nullptr};
+      // 用过的槽数(含删掉的), 只在写锁里访问
+      size_t used {0};
+    };
+    
+    struct alignas(64) Shard {
+      std::mutex lock;
+      Table* tables {nullptr};
+    };
+    
+    Shard& GetShard(int64_t key) const;
+    
+    std::unique_ptr<Shard[]> shards_;
+  };
+  
+  ShardedIndex auth_index_;
+  ShardedIndex session_index_;
+};
+
+}
+
+#endif
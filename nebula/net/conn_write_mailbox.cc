@@ -0,0 +1,126 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/conn_write_mailbox.h"
+
+#include <algorithm>
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+#include "nebula/net/base/nebula_pipeline.h"
+#include "nebula/net/thread_local_conn_manager.h"
+
+namespace nebula {
+
+ConnBroadcastPayload::ConnBroadcastPayload(std::unique_ptr<folly::IOBuf> buf, size_t header_len) {
+  folly::IOBufQueue q(folly::IOBufQueue::cacheChainLength());
+  q.append(std::move(buf));
+  header_.resize(std::min(header_len, q.chainLength()));
+  if (!header_.empty()) {
+    folly::io::Cursor c(q.front());
+    c.pull(&header_[0], header_.size());
+    q.trimStart(header_.size());
+  }
+  body_ = q.move();
+}
+
+std::unique_ptr<folly::IOBuf> ConnBroadcastPayload::MakeCopy() const {
+  auto buf = folly::IOBuf::copyBuffer(header_.data(), header_.size());
+  if (body_) {
+    buf->prependChain(body_->clone());
+  }
+  return buf;
+}
+
+ConnWriteMailbox::~ConnWriteMailbox() {
+  auto node = head_.exchange(nullptr);
+  while (node) {
+    auto next = node->next;
+    delete node;
+    node = next;
+  }
+}
+
+void ConnWriteMailbox::Post(uint64_t conn_id, std::unique_ptr<folly::IOBuf> buf) {
+  Push(new Node{conn_id, std::move(buf), nullptr, nullptr});
+}
+
+void ConnWriteMailbox::PostBroadcast(std::vector<uint64_t> conn_ids, const ConnBroadcastPayloadPtr& payload) {
+  std::unique_ptr<BroadcastBatch> batch(new BroadcastBatch{std::move(conn_ids), payload});
+  Push(new Node{0, nullptr, std::move(batch), nullptr});
+}
+
+void ConnWriteMailbox::Push(Node* node) {
+  auto head = head_.load(std::memory_order_relaxed);
+  do {
+    node->next = head;
+  } while (!head_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+  
+  if (!scheduled_.exchange(true, std::memory_order_acq_rel)) {
+    evb_->runInEventBaseThread([this]() {
+      Drain();
+    });
+  }
+}
+
+void ConnWriteMailbox::Drain() {
+  // 先清标志再取消息, 之后Post的会重新调度, 不会漏掉
+  scheduled_.store(false, std::memory_order_release);
+  auto node = head_.exchange(nullptr, std::memory_order_acquire);
+  
+  // 栈是后进先出, 反转成投递顺序
+  Node* list = nullptr;
+  while (node) {
+    auto next = node->next;
+    node->next = list;
+    list = node;
+    node = next;
+  }
+  
+  auto& conn_manager = GetConnManagerByThreadLocal();
+  while (list) {
+    if (list->batch) {
+      auto& batch = *list->batch;
+      for (auto conn_id : batch.conn_ids) {
+        auto pipeline = conn_manager.FindPipeline(conn_id);
+        if (pipeline) {
+          nebula::write<std::unique_ptr<folly::IOBuf>>(pipeline, batch.payload->MakeCopy());
+        }
+      }
+      auto next = list->next;
+      delete list;
+      list = next;
+      continue;
+    }
+    
+    auto conn_id = list->conn_id;
+    auto buf = std::move(list->buf);
+    auto next = list->next;
+    delete list;
+    list = next;
+    
+    auto pipeline = conn_manager.FindPipeline(conn_id);
+    if (!pipeline) {
+      LOG(ERROR) << "Drain - not find conn_id: " << conn_id;
+      continue;
+    }
+    nebula::write<std::unique_ptr<folly::IOBuf>>(pipeline, std::move(buf));
+  }
+}
+
+}
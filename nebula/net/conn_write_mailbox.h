@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_CONN_WRITE_MAILBOX_H_
+#define NEBULA_NET_CONN_WRITE_MAILBOX_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+
+namespace nebula {
+
+// 群发数据, 只编码一次
+// buf为编码好的完整帧, 前header_len字节(帧头, 有frame_index等每个连接不同的字段)每个连接单独复制一份,
+// 其余部分所有连接共享(IOBuf::clone), 帧头由各连接的pipeline改写
+// 创建后只读, 可以在多个线程里同时MakeCopy
+class ConnBroadcastPayload {
+public:
+  ConnBroadcastPayload(std::unique_ptr<folly::IOBuf> buf, size_t header_len);
+  
+  std::unique_ptr<folly::IOBuf> MakeCopy() const;
+  
+private:
+  std::string header_;
+  std::unique_ptr<folly::IOBuf> body_;
+};
+
+typedef std::shared_ptr<const ConnBroadcastPayload> ConnBroadcastPayloadPtr;
+
+// 跨线程发送的信箱, 每个IO线程一个, 多生产者单消费者
+// Post把(conn_id, IOBuf)压入无锁栈, 只有第一个把scheduled_置上的才调用runInEventBaseThread,
+// 一批消息只唤醒一次目标线程, 不分配Promise和闭包
+// 目标线程里一次取走全部消息, 按投递顺序逐条写出
+// 不合并同一连接的消息: pipeline按条改写帧头(frame_index), 合并后只有第一帧会被改写
+class ConnWriteMailbox {
+public:
+  explicit ConnWriteMailbox(folly::EventBase* evb)
+    : evb_(evb) {}
+  
+  ~ConnWriteMailbox();
+  
+  // 任意线程里调用
+  void Post(uint64_t conn_id, std::unique_ptr<folly::IOBuf> buf);
+  // 群发, 本线程的一批连接作为一条消息投递
+  void PostBroadcast(std::vector<uint64_t> conn_ids, const ConnBroadcastPayloadPtr& payload);
+  
+  inline folly::EventBase* GetEventBase() const {
+    return evb_;
+  }
+  
+private:
+  struct BroadcastBatch {
+    std::vector<uint64_t> conn_ids;
+    ConnBroadcastPayloadPtr payload;
+  };
+  
+  struct Node {
+    uint64_t conn_id;
+    std::unique_ptr<folly::IOBuf> buf;
+    std::unique_ptr<BroadcastBatch> batch;   // 非空为群发
+    Node* next;
+  };
+  
+  void Push(Node* node);
+  
+  // EventBase线程里执行
+  void Drain();
+  
+  folly::EventBase* evb_;
+  std::atomic<Node*> head_ {nullptr};
+  std::atomic<bool> scheduled_ {false};
+};
+
+}
+
+#endif
@@ -20,6 +20,8 @@
 
 #include <wangle/channel/EventBaseHandler.h>
 
+#include "nebula/net/base/socket_address_util.h"
+
 namespace nebula {
   
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -39,7 +41,7 @@ void SimpleConnHandler::read(Context* ctx, std::unique_ptr<folly::IOBuf> msg) {
   if (!msg) {
     // 为什么msg会为null？？？
     LOG(ERROR) << "read - recv a invalid msg_data, msg is null!!! by peer "
-    << ctx->getPipeline()->getTransportInfo()->remoteAddr->getAddressStr()
+    << nebula::ToAddressString(*ctx->getPipeline()->getTransportInfo()->remoteAddr)
     << ", name = " << name_;
     return;
   }
@@ -49,7 +51,7 @@ void SimpleConnHandler::read(Context* ctx, std::unique_ptr<folly::IOBuf> msg) {
   }
   if (rv == -1) {
     LOG(ERROR) << "read - callback_->OnDataArrived error, recv len " << msg->length()
-    << ", by peer " << ctx->getPipeline()->getTransportInfo()->remoteAddr->getAddressStr();
+    << ", by peer " << nebula::ToAddressString(*ctx->getPipeline()->getTransportInfo()->remoteAddr);
     // 直接关闭
     close(ctx);
   }
@@ -64,7 +66,7 @@ folly::Future<folly::Unit> SimpleConnHandler::write(Context* ctx, std::unique_pt
 
 void SimpleConnHandler::readEOF(Context* ctx) {
   LOG(INFO) << "readEOF - Connection closed by "
-              << ctx->getPipeline()->getTransportInfo()->remoteAddr->getAddressStr()
+              << nebula::ToAddressString(*ctx->getPipeline()->getTransportInfo()->remoteAddr)
               << ", name = " << name_;
   
   close(ctx);
@@ -72,14 +74,14 @@ void SimpleConnHandler::readEOF(Context* ctx) {
 
 void SimpleConnHandler::readException(Context* ctx, folly::exception_wrapper e) {
   LOG(ERROR) << "readException - Local error: " << exceptionStr(e)
-              << ", by "  << ctx->getPipeline()->getTransportInfo()->remoteAddr->getAddressStr();
+              << ", by "  << nebula::ToAddressString(*ctx->getPipeline()->getTransportInfo()->remoteAddr);
   
   close(ctx);
 }
 
 void SimpleConnHandler::transportActive(Context* ctx) {
   state_ = 1;
-  LOG(INFO) << "transportActive - Connection connected by " << ctx->getPipeline()->getTransportInfo()->remoteAddr->getAddressStr()
+  LOG(INFO) << "transportActive - Connection connected by " << nebula::ToAddressString(*ctx->getPipeline()->getTransportInfo()->remoteAddr)
               << ", name = " << name_;
   
   if (callback_) {
@@ -93,7 +95,7 @@ void SimpleConnHandler::transportInactive(Context* ctx) {
   }
 
   LOG(INFO) << "SimpleConnHandler - Connection closed by "
-            << ctx->getPipeline()->getTransportInfo()->remoteAddr->getAddressStr()
+            << nebula::ToAddressString(*ctx->getPipeline()->getTransportInfo()->remoteAddr)
             << ", name: " << name_;
   
   //    LOG(INFO) <<"close connection, t his:" <<std::hex << this;
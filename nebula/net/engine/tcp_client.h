@@ -23,6 +23,7 @@
 #include "nebula/net/base/nebula_pipeline.h"
 #include "nebula/net/engine/tcp_service_base.h"
 #include "nebula/net/base/client_bootstrap2.h"
+#include "nebula/net/base/socket_address_util.h"
 
 // #include "nebula/net/zproto/zproto_pipeline_factory.h"
 
@@ -43,7 +44,7 @@ public:
   TcpClient(const ServiceConfig& config, const IOThreadPoolExecutorPtr& io_group)
     : TcpServiceBase(config, io_group),
       client_(std::make_shared<wangle::ClientBootstrap2<Pipeline>>(io_group ? io_group->getEventBase() : nullptr)),
-      conn_address_(config.hosts.c_str(), static_cast<uint16_t>(config.port)) {
+      conn_address_(MakeClientAddress(config)) {
   }
   
   virtual ~TcpClient() {
@@ -18,6 +18,7 @@
 #ifndef NEBULA_NET_ENGINE_TCP_CLIENT_GROUP_H_
 #define NEBULA_NET_ENGINE_TCP_CLIENT_GROUP_H_
 
+#include "nebula/net/base/backend_health.h"
 #include "nebula/net/engine/tcp_client.h"
 
 namespace nebula {
@@ -60,7 +61,8 @@ public:
   typedef std::vector<OnlineTcpClient> OnlineTcpClientList;
 
   TcpClientGroupBase(const ServiceConfig& config, const IOThreadPoolExecutorPtr& io_group)
-    : TcpServiceBase(config, io_group) {}
+    : TcpServiceBase(config, io_group),
+      health_(config.outlier) {}
 
   virtual ~TcpClientGroupBase() = default;
 
@@ -73,6 +75,7 @@ public:
       std::lock_guard<std::mutex> g(online_mutex_);
       online_clients_.push_back(std::make_pair(conn_id, cli));
     }
+    health_.OnConnected(conn_id);
     return conn_id;
   }
   
@@ -87,6 +90,7 @@ public:
         }
       }
     }
+    health_.OnClosed(conn_id);
     
     return TcpServiceBase::OnConnectionClosed(conn_id);
   }
@@ -132,7 +136,25 @@ public:
     return rv;
   }
   
+  //////////////////////////////////////////////////////////////////////////
+  // 后端健康状态, 任意线程里调用
+  // 上报一次调用结果
+  void OnBackendResult(uint64_t conn_id, bool success, uint64_t latency_us) {
+    health_.OnResult(conn_id, success, latency_us);
+  }
+  
+  // 被摘除或恢复期内未被放行返回false
+  bool IsBackendAvailable(uint64_t conn_id) const {
+    return health_.IsAvailable(conn_id);
+  }
+  
+  void GetBackendHealthStats(std::vector<BackendHealthStats>* stats) const {
+    health_.GetStats(stats);
+  }
+  
 protected:
+  BackendHealthTracker health_;
+  
   mutable std::mutex online_mutex_;
   OnlineTcpClientList online_clients_;
   
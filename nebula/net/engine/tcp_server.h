@@ -18,14 +18,20 @@
 #ifndef NEBULA_NET_ENGINE_TCP_SERVER_H_
 #define NEBULA_NET_ENGINE_TCP_SERVER_H_
 
+#include <unistd.h>
+
+#include <stdexcept>
+
 #include <wangle/bootstrap/ServerBootstrap.h>
 
+#include "nebula/net/base/socket_address_util.h"
+#include "nebula/net/base/socket_handoff.h"
+#include "nebula/net/engine/tcp_server_acceptor.h"
+#include "nebula/net/engine/tcp_server_socket_factory.h"
 #include "nebula/net/engine/tcp_service_base.h"
 
 namespace nebula {
   
-#define DEFAULT_CONN_IDLE_TIMEOUT 240000
-  
 enum NetModuleState {
   kNetModuleState_None = 0,
 };
@@ -38,9 +44,10 @@ public:
   TcpServer(const ServiceConfig& config, const IOThreadPoolExecutorPtr& io_group)
     : TcpServiceBase(config, io_group) {
     
-    wangle::ServerSocketConfig acc_config;
-    acc_config.connectionIdleTimeout = std::chrono::milliseconds(DEFAULT_CONN_IDLE_TIMEOUT);
-    server_.acceptorConfig(acc_config);
+    // 空闲检查只用NebulaBaseHandler挂在时间轮上的(见idle_timeout)
+    // wangle的connectionIdleTimeout收到数据也不会续期, 设为0关掉(ConnectionManager不调度超时)
+    acc_config_.connectionIdleTimeout = std::chrono::milliseconds(0);
+    server_.acceptorConfig(acc_config_);
     
     // if (!io_group_) {
     //    LOG(ERROR) << "TcpServer - io_group is nil!!!!";
@@ -61,8 +68,46 @@ public:
     //    LOG(ERROR) << "Start - io_group is nil!!!!";
     // }
     server_.childPipeline(factory_);
-    server_.group(io_group_);
-    server_.bind(config_.port);
+    // accept时检查max_conn_cnt, 必须在group()之前设置
+    server_.acceptorFactory(std::make_shared<TcpServerAcceptorFactory<Pipeline>>(this, factory_, acc_config_));
+    
+    // 每个IO线程一个SO_REUSEPORT监听socket, unix domain socket不支持
+    bool per_thread_accept = config_.reuse_port &&
+                             !IsUnixAddress(config_.hosts) &&
+                             config_.unix_path.empty();
+    if (config_.reuse_port && !per_thread_accept) {
+      LOG(WARNING) << "TcpServer - reuse_port ignored for unix socket, service: " << config_.ToString();
+    }
+    if (per_thread_accept) {
+      server_.group(io_group_, io_group_);
+      server_.setReusePortEnabled(true);
+    } else {
+      server_.group(io_group_);
+    }
+    
+    // 平滑重启, 优先使用旧进程交过来的监听socket
+    socket_factory_ = std::make_shared<TcpServerSocketFactory>(per_thread_accept);
+    socket_factory_->SetInheritedFds(ListenSocketHandoff::GetInstance().TakeInheritedFds(config_.name));
+    if (!socket_factory_->MatchInheritedReusePort()) {
+      // 启动失败, 不会CompleteTakeover, 旧进程继续服务
+      // 修改reuse_port需要停掉旧进程后重启
+      socket_factory_->CloseInheritedFds();
+      LOG(ERROR) << "TcpServer - reuse_port changed, can't takeover listen sockets, service: " << config_.ToString();
+      throw std::runtime_error("TcpServer - reuse_port changed during takeover, service: " + config_.name);
+    }
+    server_.channelFactory(socket_factory_);
+    
+    if (IsUnixAddress(config_.hosts)) {
+      BindUnixPath(GetUnixPath(config_.hosts));
+    } else {
+      server_.bind(config_.port);
+      if (!config_.unix_path.empty()) {
+        BindUnixPath(config_.unix_path);
+      }
+    }
+    
+    // 配置变化(比如端口改了)后多出来的继承fd
+    socket_factory_->CloseInheritedFds();
     
     return true;
   }
@@ -75,6 +120,9 @@ public:
     LOG(INFO) << "TcpServer - Stop service: " << config_.ToString();
     
     server_.stop();
+    for (auto& path : unix_paths_) {
+      unlink(path.c_str());
+    }
     return true;
   }
   
@@ -83,7 +131,42 @@ public:
     return ServiceModuleType::TCP_SERVER;
   }
   
+  void GetListenFds(std::vector<int>* fds) const override {
+    for (auto& v : server_.getSockets()) {
+      auto socket = dynamic_cast<folly::AsyncServerSocket*>(v.get());
+      if (socket) {
+        auto socket_fds = socket->getSockets();
+        fds->insert(fds->end(), socket_fds.begin(), socket_fds.end());
+      }
+    }
+  }
+  
+  void StopAccepting() override {
+    // 新进程已经接管了监听socket, 不能再删除unix socket文件
+    unix_paths_.clear();
+    server_.stop();
+  }
+  
 private:
+  void BindUnixPath(const std::string& path) {
+    // 清掉上次进程退出时残留的文件, 否则bind失败
+    // 继承了旧进程的监听socket时文件还在用, 不能删
+    if (!socket_factory_->HasInheritedFd(AF_UNIX)) {
+      unlink(path.c_str());
+    }
+    
+    folly::SocketAddress address;
+    address.setFromPath(path);
+    server_.bind(address);
+    unix_paths_.push_back(path);
+    
+    LOG(INFO) << "TcpServer - listen unix socket: " << path << ", service: " << config_.ToString();
+  }
+  
+  std::vector<std::string> unix_paths_;
+  std::shared_ptr<TcpServerSocketFactory> socket_factory_;
+  wangle::ServerSocketConfig acc_config_;
+  
   // IOThreadPoolExecutorPtr io_group_;
   std::shared_ptr<ServerPipelineFactory> factory_;
   wangle::ServerBootstrap<Pipeline> server_;
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_ENGINE_TCP_SERVER_ACCEPTOR_H_
+#define NEBULA_NET_ENGINE_TCP_SERVER_ACCEPTOR_H_
+
+#include <wangle/bootstrap/ServerBootstrap.h>
+
+#include "nebula/net/engine/tcp_service_base.h"
+
+namespace nebula {
+
+// accept时检查max_conn_cnt
+// 连接数超限时在Acceptor::connectionAccepted里直接RST关闭fd,
+// 不创建AsyncSocket/pipeline/handler, 连接洪峰时不占内存
+template <typename Pipeline>
+class TcpServerAcceptor : public wangle::ServerAcceptor<Pipeline> {
+public:
+  TcpServerAcceptor(TcpServiceBase* service,
+                    std::shared_ptr<wangle::AcceptPipelineFactory> accept_pipeline_factory,
+                    std::shared_ptr<wangle::PipelineFactory<Pipeline>> child_pipeline_factory,
+                    const wangle::ServerSocketConfig& acc_config)
+    : wangle::ServerAcceptor<Pipeline>(accept_pipeline_factory, child_pipeline_factory, acc_config),
+      service_(service) {}
+  
+protected:
+  bool canAccept(const folly::SocketAddress& address) override {
+    // conn_count_在IO线程的transportActive里计数, 只有reuse_port时才和accept在同一线程;
+    // 否则accept线程看到的计数会落后于已经accept但还没到transportActive的连接, 洪峰时会超出一些
+    auto max_conn_cnt = service_->GetServiceConfig().max_conn_cnt;
+    if (max_conn_cnt > 0 && service_->GetConnCount() >= max_conn_cnt) {
+      LOG_EVERY_N(WARNING, 1000) << "canAccept - conn count reach max_conn_cnt: " << max_conn_cnt
+                                 << ", service: " << service_->GetServiceName();
+      return false;
+    }
+    return wangle::ServerAcceptor<Pipeline>::canAccept(address);
+  }
+  
+private:
+  TcpServiceBase* service_;
+};
+
+template <typename Pipeline>
+class TcpServerAcceptorFactory : public wangle::AcceptorFactory {
+public:
+  TcpServerAcceptorFactory(TcpServiceBase* service,
+                           std::shared_ptr<wangle::PipelineFactory<Pipeline>> child_pipeline_factory,
+                           const wangle::ServerSocketConfig& acc_config)
+    : service_(service),
+      child_pipeline_factory_(child_pipeline_factory),
+      acc_config_(acc_config) {}
+  
+  std::shared_ptr<wangle::Acceptor> newAcceptor(folly::EventBase* base) override {
+    auto acceptor = std::make_shared<TcpServerAcceptor<Pipeline>>(
+        service_,
+        std::make_shared<wangle::DefaultAcceptPipelineFactory>(),
+        child_pipeline_factory_,
+        acc_config_);
+    acceptor->init(nullptr, base, nullptr);
+    return acceptor;
+  }
+  
+private:
+  TcpServiceBase* service_;
+  std::shared_ptr<wangle::PipelineFactory<Pipeline>> child_pipeline_factory_;
+  wangle::ServerSocketConfig acc_config_;
+};
+
+}
+
+#endif
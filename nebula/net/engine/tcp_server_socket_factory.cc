@@ -0,0 +1,123 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/engine/tcp_server_socket_factory.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <folly/io/async/EventBaseManager.h>
+#include <glog/logging.h>
+
+namespace nebula {
+
+namespace {
+
+bool GetLocalAddress(int fd, folly::SocketAddress* address) {
+  try {
+    address->setFromLocalAddress(fd);
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "GetLocalAddress - invalid fd: " << fd << ", " << e.what();
+    return false;
+  }
+  return true;
+}
+
+}
+
+bool TcpServerSocketFactory::HasInheritedFd(sa_family_t family) {
+  std::lock_guard<std::mutex> g(mutex_);
+  for (auto fd : inherited_fds_) {
+    folly::SocketAddress local;
+    if (GetLocalAddress(fd, &local) && local.getFamily() == family) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TcpServerSocketFactory::MatchInheritedReusePort() {
+  std::lock_guard<std::mutex> g(mutex_);
+  for (auto fd : inherited_fds_) {
+    folly::SocketAddress local;
+    if (!GetLocalAddress(fd, &local) || local.getFamily() == AF_UNIX) {
+      continue;
+    }
+    
+    int reuse_port = 0;
+    socklen_t len = sizeof(reuse_port);
+    if (getsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse_port, &len) != 0) {
+      PLOG(ERROR) << "MatchInheritedReusePort - getsockopt error, fd: " << fd;
+      return false;
+    }
+    if ((reuse_port != 0) != per_thread_accept_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TcpServerSocketFactory::CloseInheritedFds() {
+  std::lock_guard<std::mutex> g(mutex_);
+  for (auto fd : inherited_fds_) {
+    LOG(WARNING) << "CloseInheritedFds - unused inherited fd: " << fd;
+    close(fd);
+  }
+  inherited_fds_.clear();
+}
+
+int TcpServerSocketFactory::TakeInheritedFd(const folly::SocketAddress& address) {
+  std::lock_guard<std::mutex> g(mutex_);
+  for (auto it = inherited_fds_.begin(); it != inherited_fds_.end(); ++it) {
+    folly::SocketAddress local;
+    if (!GetLocalAddress(*it, &local) || local.getFamily() != address.getFamily()) {
+      continue;
+    }
+    if (address.getFamily() == AF_UNIX ? local.getPath() != address.getPath() : local.getPort() != address.getPort()) {
+      continue;
+    }
+    
+    int fd = *it;
+    inherited_fds_.erase(it);
+    return fd;
+  }
+  return -1;
+}
+
+std::shared_ptr<folly::AsyncSocketBase> TcpServerSocketFactory::newSocket(folly::SocketAddress address,
+                                                                           int backlog,
+                                                                           bool reuse,
+                                                                           wangle::ServerSocketConfig& config) {
+  // 和AsyncServerSocketFactory一样在当前的acceptor线程里创建
+  auto evb = folly::EventBaseManager::get()->getEventBase();
+  std::shared_ptr<folly::AsyncServerSocket> socket(new folly::AsyncServerSocket(evb),
+                                                   ThreadSafeDestructor());
+  
+  int fd = TakeInheritedFd(address);
+  if (fd >= 0) {
+    socket->useExistingSocket(fd);
+  } else {
+    socket->setReusePortEnabled(reuse);
+    socket->bind(address);
+  }
+  
+  socket->listen(config.acceptBacklog);
+  socket->startAccepting();
+  return socket;
+}
+
+}
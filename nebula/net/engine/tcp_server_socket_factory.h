@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_ENGINE_TCP_SERVER_SOCKET_FACTORY_H_
+#define NEBULA_NET_ENGINE_TCP_SERVER_SOCKET_FACTORY_H_
+
+#include <mutex>
+#include <vector>
+
+#include <wangle/bootstrap/ServerSocketFactory.h>
+
+namespace nebula {
+
+// TcpServer的监听socket工厂
+//  1. 优先使用平滑重启时从旧进程继承的监听fd
+//  2. per_thread_accept: 每个IO线程一个SO_REUSEPORT监听socket,
+//     由内核在线程间均衡, 每个线程只accept自己socket上的连接, 不再跨线程投递
+class TcpServerSocketFactory : public wangle::AsyncServerSocketFactory {
+public:
+  explicit TcpServerSocketFactory(bool per_thread_accept = false)
+    : per_thread_accept_(per_thread_accept) {}
+  
+  ~TcpServerSocketFactory() override {
+    CloseInheritedFds();
+  }
+  
+  void SetInheritedFds(std::vector<int> fds) {
+    std::lock_guard<std::mutex> g(mutex_);
+    inherited_fds_ = std::move(fds);
+  }
+  
+  // 是否还有该地址族的继承fd
+  bool HasInheritedFd(sa_family_t family);
+  
+  // 继承的tcp监听fd的SO_REUSEPORT是否和per_thread_accept一致
+  // 平滑重启不支持切换reuse_port: off->on时新建的SO_REUSEPORT socket绑不上旧进程的端口(EADDRINUSE),
+  // on->off时只用得上一个组成员, 关掉其它成员会把排在它们队列里的连接RST掉
+  bool MatchInheritedReusePort();
+  
+  // 配置变化以后用不上的继承fd
+  void CloseInheritedFds();
+  
+  std::shared_ptr<folly::AsyncSocketBase> newSocket(folly::SocketAddress address,
+                                                    int backlog,
+                                                    bool reuse,
+                                                    wangle::ServerSocketConfig& config) override;
+  
+  void addAcceptCB(std::shared_ptr<folly::AsyncSocketBase> sock,
+                   wangle::Acceptor* callback,
+                   folly::EventBase* base) override {
+    if (per_thread_accept_ && sock->getEventBase() != base) {
+      return;
+    }
+    AsyncServerSocketFactory::addAcceptCB(sock, callback, base);
+  }
+  
+  void removeAcceptCB(std::shared_ptr<folly::AsyncSocketBase> sock,
+                      wangle::Acceptor* callback,
+                      folly::EventBase* base) override {
+    if (per_thread_accept_ && sock->getEventBase() != base) {
+      return;
+    }
+    AsyncServerSocketFactory::removeAcceptCB(sock, callback, base);
+  }
+  
+private:
+  // 取出和address匹配的继承fd, 没有返回-1
+  int TakeInheritedFd(const folly::SocketAddress& address);
+  
+  bool per_thread_accept_ {false};
+  
+  std::mutex mutex_;
+  std::vector<int> inherited_fds_;
+};
+
+}
+
+#endif
@@ -23,10 +23,12 @@ namespace nebula {
 
 // TODO(@benqi): 不直接使用GetConnManagerByThreadLocal, 通过回调注册来进行调用
 uint64_t TcpServiceBase::OnNewConnection(wangle::PipelineBase* pipeline) {
+  conn_count_.fetch_add(1, std::memory_order_relaxed);
   return GetConnManagerByThreadLocal().OnNewConnection(pipeline);
 }
 
 bool TcpServiceBase::OnConnectionClosed(uint64_t conn_id) {
+  conn_count_.fetch_sub(1, std::memory_order_relaxed);
   return GetConnManagerByThreadLocal().OnConnectionClosed(conn_id);
 }
 
@@ -18,11 +18,15 @@
 #ifndef NEBULA_NET_ENGINE_TCP_SERVICE_BASE_H_
 #define NEBULA_NET_ENGINE_TCP_SERVICE_BASE_H_
 
+#include <atomic>
+#include <vector>
+
 // #include <wangle/channel/Pipeline.h>
 #include <wangle/concurrent/IOThreadPoolExecutor.h>
 
 #include "nebula/net/base/tcp_conn_event_callback.h"
 #include "nebula/net/base/nebula_pipeline.h"
+#include "nebula/net/base/rate_limiter.h"
 #include "nebula/net/base/service_base.h"
 
 using IOThreadPoolExecutorPtr = std::shared_ptr<wangle::IOThreadPoolExecutor>;
@@ -34,7 +38,11 @@ class TcpServiceBase : public ServiceBase, public TcpConnEventCallback {
 public:
   TcpServiceBase(const ServiceConfig& config, const IOThreadPoolExecutorPtr& io_group)
     : ServiceBase(config),
-      io_group_(io_group) {}
+      io_group_(io_group) {
+    if (config.rate_limit.enabled()) {
+      rate_limiter_ = std::make_shared<TokenBucketRateLimiter>(config.rate_limit);
+    }
+  }
   
   virtual ~TcpServiceBase() = default;
 
@@ -48,8 +56,26 @@ public:
     return io_group_;
   }
   
+  // 未配置限流时返回nullptr
+  inline TokenBucketRateLimiter* GetRateLimiter() const {
+    return rate_limiter_.get();
+  }
+  
+  // 当前连接数
+  inline uint32_t GetConnCount() const {
+    return conn_count_.load(std::memory_order_relaxed);
+  }
+  
+  // 平滑重启, 只有监听服务实现
+  // 监听fd, 交给新进程
+  virtual void GetListenFds(std::vector<int>* fds) const {}
+  // 停止accept, 已有连接不受影响
+  virtual void StopAccepting() {}
+  
 protected:
   IOThreadPoolExecutorPtr io_group_;
+  std::atomic<uint32_t> conn_count_ {0};
+  std::shared_ptr<TokenBucketRateLimiter> rate_limiter_;
   
   // TODO(@benqi): 通过回调转发conn事件
   // TcpConnEventCallback* callback_;
@@ -0,0 +1,285 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/handler/conn_flow_control_handler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <wangle/channel/AsyncSocketHandler.h>
+
+#include "nebula/net/base/socket_address_util.h"
+#include "nebula/net/thread_local_conn_manager.h"
+
+namespace nebula {
+
+namespace {
+
+// 超预算时的检查间隔(毫秒)
+#define BUDGET_CHECK_INTERVAL 100
+
+typedef ConnFlowControlHandler::State FlowControlState;
+
+std::string GetRemoteAddress(FlowControlState* state) {
+  auto transport_info = state->ctx->getPipeline()->getTransportInfo();
+  return transport_info && transport_info->remoteAddr ?
+      ToAddressString(*transport_info->remoteAddr) : std::string();
+}
+
+// 暂停读的原因有水位和预算两个, 都解除了才恢复读
+void UpdateReadState(FlowControlState* state) {
+  bool pause = state->paused_by_watermark || state->paused_by_budget;
+  if (pause == state->read_paused || !state->ctx) {
+    return;
+  }
+  
+  auto socket_handler = state->ctx->getPipeline()->getHandler<wangle::AsyncSocketHandler>();
+  if (socket_handler) {
+    if (pause) {
+      socket_handler->detachReadCallback();
+    } else {
+      socket_handler->attachReadCallback();
+    }
+  }
+  state->read_paused = pause;
+}
+
+// 每个IO线程一份, 只在本线程里访问
+class ThreadBudgetChecker : public folly::HHWheelTimer::Callback,
+                            private folly::EventBase::LoopCallback {
+public:
+  void Add(FlowControlState* state) {
+    if (!evb_) {
+      // thread_local在线程退出时才析构, 可能晚于EventBase, 在EventBase销毁时就取消定时器
+      evb_ = folly::EventBaseManager::get()->getEventBase();
+      evb_->runOnDestruction(this);
+    }
+    states_.insert(state);
+  }
+  
+  void Remove(FlowControlState* state) {
+    states_.erase(state);
+  }
+  
+  // 预算变化后调用, 超预算时尽快检查
+  void OnChanged() {
+    if (!isScheduled() && NetMemoryBudget::GetInstance().IsOverBudget()) {
+      GetConnManagerByThreadLocal().GetWheelTimer().scheduleTimeout(this, std::chrono::milliseconds(0));
+    }
+  }
+  
+  void timeoutExpired() noexcept override {
+    Check();
+  }
+  void callbackCanceled() noexcept override {}
+  
+private:
+  // EventBase销毁
+  void runLoopCallback() noexcept override {
+    cancelTimeout();
+    states_.clear();
+    evb_ = nullptr;
+  }
+  
+  void Check() {
+    auto& budget = NetMemoryBudget::GetInstance();
+    int64_t total = budget.GetTotalBytes();
+    bool has_paused = false;
+    
+    if (total > static_cast<int64_t>(budget.budget())) {
+      // 按本线程占用比例承担超出部分, 从占用最多的连接开始处理
+      std::vector<std::shared_ptr<FlowControlState>> states;
+      int64_t thread_bytes = 0;
+      for (auto state : states_) {
+        thread_bytes += state->buffered_bytes();
+        if (!state->paused_by_budget && state->buffered_bytes() > 0) {
+          states.push_back(state->shared_from_this());
+        }
+      }
+      std::sort(states.begin(), states.end(),
+                [](const std::shared_ptr<FlowControlState>& a, const std::shared_ptr<FlowControlState>& b) {
+                  return a->buffered_bytes() > b->buffered_bytes();
+                });
+      
+      // 两个字节数相乘可能溢出int64_t, 用double算
+      int64_t need = static_cast<int64_t>(static_cast<double>(total - static_cast<int64_t>(budget.resume_mark())) *
+                                          thread_bytes / total);
+      for (auto& state : states) {
+        if (need <= 0 || !state->ctx) break;
+        need -= state->buffered_bytes();
+        
+        LOG(WARNING) << "Check - over net memory budget: " << total
+                     << ", conn buffered bytes: " << state->buffered_bytes()
+                     << ", shed: " << budget.shed()
+                     << ", remote: " << GetRemoteAddress(state.get());
+        if (budget.shed()) {
+          state->ctx->fireClose();
+        } else {
+          state->paused_by_budget = true;
+          UpdateReadState(state.get());
+        }
+      }
+    } else if (total <= static_cast<int64_t>(budget.resume_mark())) {
+      for (auto state : states_) {
+        if (state->paused_by_budget) {
+          state->paused_by_budget = false;
+          UpdateReadState(state);
+        }
+      }
+    }
+    
+    for (auto state : states_) {
+      if (state->paused_by_budget) {
+        has_paused = true;
+        break;
+      }
+    }
+    
+    // 还有暂停的连接时要一直检查, 否则没有事件触发恢复
+    if (has_paused || budget.IsOverBudget()) {
+      GetConnManagerByThreadLocal().GetWheelTimer().scheduleTimeout(this,
+          std::chrono::milliseconds(BUDGET_CHECK_INTERVAL));
+    }
+  }
+  
+  std::unordered_set<FlowControlState*> states_;
+  folly::EventBase* evb_ {nullptr};
+};
+
+ThreadBudgetChecker& GetThreadBudgetChecker() {
+  static thread_local ThreadBudgetChecker g_checker;
+  return g_checker;
+}
+
+// 更新计数, 只在启用了预算时检查
+void AddBufferedBytes(FlowControlState* state, int64_t delta) {
+  auto& budget = NetMemoryBudget::GetInstance();
+  budget.Add(state->account, delta);
+  if (delta > 0 && budget.enabled() && state->ctx) {
+    GetThreadBudgetChecker().OnChanged();
+  }
+}
+
+}
+
+ConnFlowControlHandler::ConnFlowControlHandler(const ServiceConfig& config)
+  : state_(std::make_shared<State>()) {
+  state_->account = NetMemoryBudget::GetInstance().GetAccount(config.name);
+  state_->high_watermark = config.write_high_watermark;
+  state_->low_watermark = config.write_low_watermark;
+  state_->policy = config.write_overflow_policy;
+}
+
+void ConnFlowControlHandler::attachPipeline(Context* ctx) {
+  state_->ctx = ctx;
+  GetThreadBudgetChecker().Add(state_.get());
+}
+
+void ConnFlowControlHandler::detachPipeline(Context* ctx) {
+  state_->ctx = nullptr;
+  GetThreadBudgetChecker().Remove(state_.get());
+  
+  // 待发送数据在写完成(或失败)回调里扣除
+  AddBufferedBytes(state_.get(), -static_cast<int64_t>(state_->read_bytes));
+  state_->read_bytes = 0;
+}
+
+void ConnFlowControlHandler::read(Context* ctx, folly::IOBufQueue& q) {
+  ctx->fireRead(q);
+  
+  // 解码后剩下的是不完整的包
+  size_t read_bytes = q.chainLength();
+  if (read_bytes != state_->read_bytes) {
+    AddBufferedBytes(state_.get(), static_cast<int64_t>(read_bytes) - static_cast<int64_t>(state_->read_bytes));
+    state_->read_bytes = read_bytes;
+  }
+}
+
+folly::Future<folly::Unit> ConnFlowControlHandler::write(Context* ctx, std::unique_ptr<folly::IOBuf> buf) {
+  if (!buf) {
+    return ctx->fireWrite(std::move(buf));
+  }
+  
+  size_t len = buf->computeChainDataLength();
+  if (state_->high_watermark > 0 && state_->policy == WriteOverflowPolicy::CLOSE &&
+      (state_->over_high || state_->pending_bytes + len > state_->high_watermark)) {
+    // CLOSE: 超过高水位的数据不再写出, 关闭连接, 让调用方知道写失败
+    if (!state_->over_high) {
+      OnHighWatermark(state_.get());
+    }
+    return folly::makeFuture<folly::Unit>(
+        folly::make_exception_wrapper<std::runtime_error>("ConnFlowControlHandler - over write high watermark, conn closed"));
+  }
+  
+  state_->pending_bytes += len;
+  AddBufferedBytes(state_.get(), static_cast<int64_t>(len));
+  
+  auto state = state_;
+  // 能一次写完时回调会同步执行, pending_bytes马上减回去
+  auto f = ctx->fireWrite(std::move(buf)).ensure([state, len]() {
+    state->pending_bytes -= len;
+    AddBufferedBytes(state.get(), -static_cast<int64_t>(len));
+    if (state->over_high && state->policy == WriteOverflowPolicy::PAUSE_READ &&
+        state->pending_bytes <= state->low_watermark) {
+      OnLowWatermark(state.get());
+    }
+  });
+  
+  if (state_->high_watermark > 0 && !state_->over_high && state_->pending_bytes > state_->high_watermark) {
+    OnHighWatermark(state_.get());
+  }
+  return f;
+}
+
+void ConnFlowControlHandler::OnHighWatermark(State* state) {
+  state->over_high = true;
+  if (!state->ctx) {
+    return;
+  }
+  
+  LOG(WARNING) << "OnHighWatermark - pending write bytes: " << state->pending_bytes
+               << ", high_watermark: " << state->high_watermark
+               << ", policy: " << static_cast<int>(state->policy)
+               << ", remote: " << GetRemoteAddress(state);
+  
+  switch (state->policy) {
+    case WriteOverflowPolicy::PAUSE_READ:
+      state->paused_by_watermark = true;
+      UpdateReadState(state);
+      break;
+    case WriteOverflowPolicy::CLOSE:
+      state->ctx->fireClose();
+      break;
+  }
+}
+
+void ConnFlowControlHandler::OnLowWatermark(State* state) {
+  state->over_high = false;
+  if (!state->ctx) {
+    return;
+  }
+  
+  if (state->paused_by_watermark) {
+    state->paused_by_watermark = false;
+    UpdateReadState(state);
+  }
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NUBULA_NET_HANDLER_CONN_FLOW_CONTROL_HANDLER_H_
+#define NUBULA_NET_HANDLER_CONN_FLOW_CONTROL_HANDLER_H_
+
+#include <wangle/channel/Handler.h>
+
+#include "nebula/net/base/net_memory_budget.h"
+#include "nebula/net/base/service_config.h"
+
+namespace nebula {
+
+// 连接写缓冲水位控制和进程级网络缓冲预算
+// 放在AsyncSocketHandler后面(有EventBaseHandler时放在它前面, 保证在IO线程里执行)
+// 1. 统计已经交给socket但还未写完的字节数:
+//    超过高水位按WriteOverflowPolicy处理(暂停读/关闭), 回落到低水位以下恢复
+//    CLOSE时超出高水位的写不再往下传, 返回的future失败
+// 2. 统计读缓冲里还未解出完整包的字节数, 连同待发送数据计入NetMemoryBudget
+//    超出预算时本线程从占用最多的连接开始暂停读(或关闭)
+class ConnFlowControlHandler : public wangle::BytesToBytesHandler {
+public:
+  explicit ConnFlowControlHandler(const ServiceConfig& config);
+  
+  static bool IsEnabled(const ServiceConfig& config) {
+    return config.write_high_watermark > 0 || NetMemoryBudget::GetInstance().enabled();
+  }
+  
+  void read(Context* ctx, folly::IOBufQueue& q) override;
+  folly::Future<folly::Unit> write(Context* ctx, std::unique_ptr<folly::IOBuf> buf) override;
+  
+  void attachPipeline(Context* ctx) override;
+  void detachPipeline(Context* ctx) override;
+  
+  // 写完成回调可能在handler销毁后才执行, 状态放在shared_ptr里
+  struct State : public std::enable_shared_from_this<State> {
+    Context* ctx {nullptr};
+    NetMemoryAccount* account {nullptr};
+    
+    size_t pending_bytes {0};
+    size_t read_bytes {0};
+    bool over_high {false};         // 已超过高水位, 等待回落(CLOSE时不再恢复)
+    
+    bool read_paused {false};
+    bool paused_by_watermark {false};
+    bool paused_by_budget {false};
+    
+    size_t high_watermark {0};
+    size_t low_watermark {0};
+    WriteOverflowPolicy policy {WriteOverflowPolicy::PAUSE_READ};
+    
+    inline size_t buffered_bytes() const {
+      return pending_bytes + read_bytes;
+    }
+  };
+  
+private:
+  static void OnHighWatermark(State* state);
+  static void OnLowWatermark(State* state);
+  
+  std::shared_ptr<State> state_;
+};
+
+}
+
+#endif
@@ -23,6 +23,7 @@
 #include <wangle/codec/StringCodec.h>
 
 #include "nebula/net/base/nebula_pipeline.h"
+#include "nebula/net/base/socket_address_util.h"
 #include "nebula/net/engine/tcp_client_group.h"
 #include "nebula/net/engine/tcp_client.h"
 #include "nebula/net/engine/tcp_server.h"
@@ -62,7 +63,7 @@ void ModuleEchoInitialize() {
 ///////////////////////////////////////////////////////////////////////////////////////
 void EchoHandler::transportActive(Context* ctx) {
   auto pipeline = dynamic_cast<EchoPipeline*>(ctx->getPipeline());
-  OnNewConnection(pipeline, pipeline->getTransportInfo()->remoteAddr->getAddressStr());
+  OnNewConnection(pipeline, nebula::ToAddressString(*pipeline->getTransportInfo()->remoteAddr));
   
   LOG(INFO) << "transportActive - conn_id = " << conn_id_
             << ", ZProtoHandler - Connection connected by "
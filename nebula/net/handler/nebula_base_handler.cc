@@ -17,6 +17,11 @@
 
 #include "nebula/net/handler/nebula_base_handler.h"
 
+#include <folly/Hash.h>
+
+#include "nebula/net/conn_index.h"
+#include "nebula/net/thread_local_conn_manager.h"
+
 namespace nebula {
   
 uint64_t NebulaBaseHandler::OnNewConnection(wangle::PipelineBase* pipeline, const std::string& remote_address) {
@@ -24,13 +29,84 @@ uint64_t NebulaBaseHandler::OnNewConnection(wangle::PipelineBase* pipeline, cons
   // TODO(@benqi): 检查输入参数以及状态
   conn_state_ = ConnState::CONNECTED;
   remote_address_ = remote_address;
+  remote_address_hash_ = folly::hash::fnv64(remote_address_);
   conn_id_ = service_->OnNewConnection(pipeline);
+  pipeline_ = pipeline;
 
+  // 服务端空闲连接检查
+  // rpc_client没有心跳, rpc_server上的空闲链路是正常的, 不检查
+  auto idle_timeout = service_->GetServiceConfig().idle_timeout;
+  if (idle_timeout > 0 && service_->GetModuleType() == ServiceModuleType::TCP_SERVER) {
+    GetConnManagerByThreadLocal().GetWheelTimer().scheduleTimeout(&idle_timeout_,
+                                                                  std::chrono::milliseconds(idle_timeout));
+  }
+  
   return conn_id_;
 }
 
+void NebulaBaseHandler::OnIdleTimeout() {
+  if (conn_state_ != ConnState::CONNECTED) {
+    return;
+  }
+  
+  auto transport = pipeline_->getTransport();
+  size_t bytes_received = transport ? transport->getAppBytesReceived() : 0;
+  if (bytes_received != last_bytes_received_) {
+    // 一个周期内有数据(包括心跳), 重新计时
+    last_bytes_received_ = bytes_received;
+    GetConnManagerByThreadLocal().GetWheelTimer().scheduleTimeout(&idle_timeout_,
+        std::chrono::milliseconds(service_->GetServiceConfig().idle_timeout));
+    return;
+  }
+  
+  LOG(INFO) << "OnIdleTimeout - close idle conn: " << remote_address_
+            << ", conn_id: " << conn_id_
+            << ", service: " << service_->GetServiceName();
+  pipeline_->close();
+}
+
+void NebulaBaseHandler::BindAuth(int64_t auth_id, int64_t session_id) {
+  if (conn_state_ != ConnState::CONNECTED ||
+      (auth_id == auth_id_ && session_id == session_id_)) {
+    return;
+  }
+  
+  auto& conn_index = ConnIndex::GetInstance();
+  conn_index.Unbind(conn_id_, auth_id_, session_id_);
+  auth_id_ = auth_id;
+  session_id_ = session_id;
+  conn_index.Bind(conn_id_, auth_id_, session_id_);
+}
+
+bool NebulaBaseHandler::CheckRateLimit(int32_t method_id, int32_t* delay) {
+  auto limiter = service_->GetRateLimiter();
+  if (!limiter) {
+    return true;
+  }
+  
+  // 只用服务端确定的身份, 包头里的auth_id由客户端填写, 不能作为限流的key
+  uint64_t key = conn_id_;
+  switch (limiter->GetKeyType()) {
+    case RateLimitKeyType::AUTH_ID:
+      // 认证前按对端地址, 最高位区分开, 不和auth_id冲突
+      key = auth_id_ > 0 ? static_cast<uint64_t>(auth_id_) : (remote_address_hash_ | (1ULL << 63));
+      break;
+    case RateLimitKeyType::REMOTE_ADDRESS:
+      key = remote_address_hash_;
+      break;
+    default:
+      break;
+  }
+  
+  return limiter->Acquire(key, method_id, delay);
+}
+
 void NebulaBaseHandler::OnConnectionClosed() {
   if (conn_state_ == ConnState::CONNECTED) {
+    idle_timeout_.cancelTimeout();
+    ConnIndex::GetInstance().Unbind(conn_id_, auth_id_, session_id_);
+    auth_id_ = 0;
+    session_id_ = 0;
     service_->OnConnectionClosed(conn_id_);
     conn_state_ = ConnState::CLOSED;
     remote_address_.clear();
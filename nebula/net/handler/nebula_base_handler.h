@@ -18,6 +18,7 @@
 #ifndef NUBULA_NET_HANDLER_NEBULA_BASE_HANDLER_H_
 #define NUBULA_NET_HANDLER_NEBULA_BASE_HANDLER_H_
 
+#include <folly/io/async/HHWheelTimer.h>
 #include <wangle/channel/Handler.h>
 
 #include "nebula/net/engine/tcp_service_base.h"
@@ -45,7 +46,8 @@ public:
   explicit NebulaBaseHandler(ServiceBase* service)
     : service_(dynamic_cast<TcpServiceBase*>(service)),
       conn_id_(0),
-      conn_state_(ConnState::NONE) {
+      conn_state_(ConnState::NONE),
+      idle_timeout_(this) {
   
   }
   
@@ -90,6 +92,24 @@ public:
     return remote_address_;
   }
   
+  // 认证完成后调用, 建立auth_id/session_id到conn_id的索引(见ConnIndex), 连接关闭时自动删除
+  // 再次调用会替换掉之前的绑定
+  // 注意: 包头里的auth_id由客户端填写, 不可信, 只能在服务端确认认证通过的地方调用,
+  //  zproto连接在服务端发出ResponseDoDH时由ZProtoPackageHandler自动绑定
+  // 必须在连接所属的IO线程里调用
+  void BindAuth(int64_t auth_id, int64_t session_id);
+  
+  inline int64_t GetAuthID() const {
+    return auth_id_;
+  }
+  inline int64_t GetSessionID() const {
+    return session_id_;
+  }
+  
+  // 服务端限流检查, 超限返回false, delay为建议等待秒数
+  // 按BindAuth绑定的auth_id(认证前按对端地址)、conn_id或对端地址计数
+  bool CheckRateLimit(int32_t method_id, int32_t* delay);
+  
   inline bool IsTcpServer() const {
     return service_->GetServiceType() == "tcp_server";
   }
@@ -99,6 +119,24 @@ public:
   }
 
 protected:
+  // 空闲连接检查, 挂在本IO线程的时间轮上
+  // 读数据时不动定时器, 到期时看收到的字节数有没有变化, 有变化则重新计时
+  class IdleTimeout : public folly::HHWheelTimer::Callback {
+  public:
+    explicit IdleTimeout(NebulaBaseHandler* handler)
+      : handler_(handler) {}
+    
+    void timeoutExpired() noexcept override {
+      handler_->OnIdleTimeout();
+    }
+    void callbackCanceled() noexcept override {}
+    
+  private:
+    NebulaBaseHandler* handler_;
+  };
+  
+  void OnIdleTimeout();
+  
   // 全局的
   TcpServiceBase* service_{nullptr};
   uint64_t conn_id_ {0};
@@ -106,6 +144,14 @@ protected:
   ConnState conn_state_ {ConnState::NONE};
   
   std::string remote_address_;
+  uint64_t remote_address_hash_ {0};
+  
+  int64_t auth_id_ {0};
+  int64_t session_id_ {0};
+  
+  wangle::PipelineBase* pipeline_ {nullptr};
+  IdleTimeout idle_timeout_;
+  size_t last_bytes_received_ {0};
 };
 
 class NebulaBasePipelineFactory {
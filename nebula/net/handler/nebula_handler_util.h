@@ -27,6 +27,7 @@
 #include "nebula/net/thread_local_conn_manager.h"
 #include "nebula/net/engine/tcp_client_group.h"
 #include "nebula/net/net_engine_manager.h"
+#include "nebula/net/zproto/zproto_frame_data.h"
 
 // 用一个结构体的
 struct WriterUtil {
@@ -82,6 +83,69 @@ struct WriterUtil {
     }
   }
   
+  // 不关心发送结果的Write, 不返回future
+  // 跨线程时放进目标线程的mailbox, 一批消息只唤醒一次, 大量推送时用这个
+  static void Post(uint64_t conn_id, std::unique_ptr<folly::IOBuf> buf) {
+    auto net_engine = nebula::NetEngineManager::GetInstance();
+    
+    size_t tid = conn_id >> 32;
+    if (tid >= net_engine->thread_datas_size() || !net_engine->thread_datas(tid).mailbox) {
+      LOG(ERROR) << "Post - invalid error, not find thread_id: " << nebula::ToString(conn_id);
+      return;
+    }
+    
+    auto& mailbox = net_engine->thread_datas(tid).mailbox;
+    if (mailbox->GetEventBase()->isInEventBaseThread()) {
+      auto pipeline = nebula::GetConnManagerByThreadLocal().FindPipeline(conn_id);
+      if (!pipeline) {
+        LOG(ERROR) << "Post - invalid error, not find conn_id: " << nebula::ToString(conn_id);
+        return;
+      }
+      nebula::write<std::unique_ptr<folly::IOBuf>>(pipeline, std::move(buf));
+    } else {
+      mailbox->Post(conn_id, std::move(buf));
+    }
+  }
+  
+  // 群发: 同一份编码好的数据发给一批连接
+  // 按所属IO线程分组, 每个线程投递一次, 每个连接只复制header_len字节的帧头, 其余部分共享
+  static void Broadcast(const std::vector<uint64_t>& conn_ids,
+                        std::unique_ptr<folly::IOBuf> buf,
+                        size_t header_len = Frame::HEADER_LEN) {
+    auto net_engine = nebula::NetEngineManager::GetInstance();
+    auto payload = std::make_shared<const nebula::ConnBroadcastPayload>(std::move(buf), header_len);
+    
+    std::vector<std::vector<uint64_t>> thread_conn_ids(net_engine->thread_datas_size());
+    for (auto conn_id : conn_ids) {
+      size_t tid = conn_id >> 32;
+      if (tid >= thread_conn_ids.size()) {
+        LOG(ERROR) << "Broadcast - invalid error, not find thread_id: " << nebula::ToString(conn_id);
+        continue;
+      }
+      thread_conn_ids[tid].push_back(conn_id);
+    }
+    
+    for (size_t tid = 0; tid < thread_conn_ids.size(); ++tid) {
+      auto& ids = thread_conn_ids[tid];
+      auto& mailbox = net_engine->thread_datas(tid).mailbox;
+      if (ids.empty() || !mailbox) {
+        continue;
+      }
+      
+      if (mailbox->GetEventBase()->isInEventBaseThread()) {
+        auto& conn_manager = nebula::GetConnManagerByThreadLocal();
+        for (auto conn_id : ids) {
+          auto pipeline = conn_manager.FindPipeline(conn_id);
+          if (pipeline) {
+            nebula::write<std::unique_ptr<folly::IOBuf>>(pipeline, payload->MakeCopy());
+          }
+        }
+      } else {
+        mailbox->PostBroadcast(std::move(ids), payload);
+      }
+    }
+  }
+  
   template <typename T>
   static folly::Future<folly::Unit> Write(const std::string& service_name, T msg) {
     auto net_engine = nebula::NetEngineManager::GetInstance();
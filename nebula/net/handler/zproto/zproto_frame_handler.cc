@@ -254,6 +254,19 @@ void ZProtoFrameHandler::OnHandshakeResponse(Context* ctx, std::shared_ptr<Frame
   LOG(INFO) << "OnHandshakeResponse - recv handshake_response";
 }
 
+void ZProtoFrameHandler::SendRedirect(const std::string& host, int port, int timeout) {
+  auto ctx = getContext();
+  if (!ctx) {
+    return;
+  }
+  
+  Redirect redirect;
+  redirect.host = host;
+  redirect.port = port;
+  redirect.timeout = timeout;
+  WriteFrameMessage(ctx, &redirect);
+}
+
 void ZProtoFrameHandler::WriteFrameMessage(Context *ctx, const FrameMessage* message) {
   std::unique_ptr<folly::IOBuf> io_buf;
   if (!message->SerializeToIOBuf(io_buf)) {
@@ -83,6 +83,9 @@ public:
   void OnAck(Context* ctx, std::shared_ptr<FrameMessage> message);
   void OnHandshake(Context* ctx, std::shared_ptr<FrameMessage> message);
   void OnHandshakeResponse(Context* ctx, std::shared_ptr<FrameMessage> message);
+  
+  // 通知客户端重连到host:port, 必须在连接所在的IO线程里调用
+  void SendRedirect(const std::string& host, int port, int timeout);
           
 private:
   void WriteFrameMessage(Context *ctx, const FrameMessage* message);
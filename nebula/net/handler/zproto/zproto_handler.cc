@@ -22,6 +22,7 @@
 #include <wangle/codec/LineBasedFrameDecoder.h>
 #include <wangle/codec/StringCodec.h>
 
+#include "nebula/net/base/socket_address_util.h"
 #include "nebula/net/engine/tcp_client_group.h"
 #include "nebula/net/engine/tcp_client.h"
 #include "nebula/net/engine/tcp_server.h"
@@ -63,6 +64,19 @@ static ServiceSelfRegisterTemplate g_reg_zproto_tcp_server(std::make_pair("tcp_s
 ///////////////////////////////////////////////////////////////////////////////////////////
 void ZProtoHandler::read(Context* ctx, std::shared_ptr<PackageMessage> msg) {
   LOG(INFO) << "read - received data: "; // << msg;
+  
+  if (msg->GetPackageType() == Package::RPC_REQUEST) {
+    // 超限直接应答RpcFloodWait, 不再交给上层处理
+    auto request = std::static_pointer_cast<RpcRequest>(msg);
+    int32_t delay = 0;
+    if (!CheckRateLimit(request->GetMethodID(), &delay)) {
+      std::unique_ptr<folly::IOBuf> out;
+      RpcFloodWait(request->message_id(), delay).SerializeToIOBuf(out);
+      ctx->fireWrite(std::move(out));
+      return;
+    }
+  }
+  
   auto pipeline = dynamic_cast<ZProtoPipeline*>(ctx->getPipeline());
 
   int rv = ZProtoEventCallback::OnDataReceived(pipeline, msg);
@@ -88,7 +102,7 @@ void ZProtoHandler::readException(Context* ctx, folly::exception_wrapper e) {
 
 void ZProtoHandler::transportActive(Context* ctx) {
   auto pipeline = dynamic_cast<ZProtoPipeline*>(ctx->getPipeline());
-  OnNewConnection(pipeline, pipeline->getTransportInfo()->remoteAddr->getAddressStr());
+  OnNewConnection(pipeline, nebula::ToAddressString(*pipeline->getTransportInfo()->remoteAddr));
   
   LOG(INFO) << "transportActive - conn_id = " << conn_id_
             << ", ZProtoHandler - Connection connected by "
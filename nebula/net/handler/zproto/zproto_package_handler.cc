@@ -17,7 +17,10 @@
 
 #include "nebula/net/handler/zproto/zproto_package_handler.h"
 
+#include <folly/io/Cursor.h>
+
 #include "nebula/base/func_factory_manager.h"
+#include "nebula/net/handler/zproto/zproto_handler.h"
 
 ///////////////////////////////////////////////////////////////////////////////////////
 // 初始化
@@ -83,6 +86,51 @@ void ZProtoPackageHandler::read(Context* ctx, std::shared_ptr<ProtoRawData> msg)
   // ExecPackageHandlerFactory::Execute2<ZProtoPackageHandler>(this, package.package_type, ctx, message_data);
 }
 
+folly::Future<folly::Unit> ZProtoPackageHandler::write(Context* ctx, std::unique_ptr<folly::IOBuf> msg) {
+  // 包头由服务端自己填写, 可信, 不用客户端RequestDH里的auth_id
+  if (msg && msg->computeChainDataLength() >= Frame::HEADER_LEN + Package::HEADER_LEN) {
+    folly::io::Cursor c(msg.get());
+    c.skip(Frame::HEADER_LEN);
+    auto auth_id = c.readBE<int64_t>();
+    auto session_id = c.readBE<int64_t>();
+    c.skip(sizeof(int64_t)); // message_id
+    if (c.readBE<uint8_t>() == Package::RESPONSE_DO_DH) {
+      OnAuthCompleted(ctx, auth_id, session_id);
+    }
+  }
+  
+  return ctx->fireWrite(std::move(msg));
+}
+
+void ZProtoPackageHandler::OnAuthCompleted(Context* ctx, int64_t auth_id, int64_t session_id) {
+  auto transport = ctx->getTransport();
+  if (!transport) {
+    return;
+  }
+  
+  // BindAuth会写ConnIndex, 只能在连接所属的IO线程里调用
+  auto evb = transport->getEventBase();
+  if (evb->isInEventBaseThread()) {
+    auto handler = ctx->getPipeline()->getHandler<ZProtoHandler>();
+    if (handler) {
+      handler->BindAuth(auth_id, session_id);
+    }
+    return;
+  }
+  
+  std::weak_ptr<wangle::PipelineBase> capture_pipeline = ctx->getPipelineShared();
+  evb->runInEventBaseThread([capture_pipeline, auth_id, session_id]() {
+    auto pipeline = capture_pipeline.lock();
+    if (!pipeline) {
+      return;
+    }
+    auto handler = pipeline->getHandler<ZProtoHandler>();
+    if (handler) {
+      handler->BindAuth(auth_id, session_id);
+    }
+  });
+}
+
 ////////////////////////////////////////////////////////////////////////////
 void ZProtoPackageHandler::OnAuthIdInvalid(Context* ctx, std::shared_ptr<PackageMessage> message) {
   
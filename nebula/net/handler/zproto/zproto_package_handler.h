@@ -31,9 +31,8 @@ public:
   
   void read(Context* ctx, std::shared_ptr<ProtoRawData> msg) override;
   
-  folly::Future<folly::Unit> write(Context* ctx, std::unique_ptr<folly::IOBuf> msg) override {
-    return ctx->fireWrite(std::forward<std::unique_ptr<folly::IOBuf>>(msg));
-  }
+  // 服务端发出ResponseDoDH即DH握手完成、认证通过, 在这里调用ZProtoHandler::BindAuth
+  folly::Future<folly::Unit> write(Context* ctx, std::unique_ptr<folly::IOBuf> msg) override;
 
   ////////////////////////////////////////////////////////////////////////////
   // Auth
@@ -75,6 +74,9 @@ public:
   void OnNewSession(Context* ctx, std::shared_ptr<PackageMessage> message);
   void OnSessionHello(Context* ctx, std::shared_ptr<PackageMessage> message);
   void OnSessionLost(Context* ctx, std::shared_ptr<PackageMessage> message);
+
+private:
+  void OnAuthCompleted(Context* ctx, int64_t auth_id, int64_t session_id);
 };
 
 #endif
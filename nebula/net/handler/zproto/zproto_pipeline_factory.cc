@@ -21,6 +21,7 @@
 #include <wangle/channel/AsyncSocketHandler.h>
 
 #include "nebula/net/thread_local_conn_manager.h"
+#include "nebula/net/handler/conn_flow_control_handler.h"
 
 #include "nebula/net/handler/zproto/zproto_frame_handler.h"
 #include "nebula/net/handler/zproto/zproto_package_handler.h"
@@ -36,6 +37,9 @@ const uint64_t kDefaultAllocationSize = 16192;
 nebula::ZProtoPipeline::Ptr ZProtoPipelineFactory::newPipeline(std::shared_ptr<folly::AsyncTransportWrapper> sock) {
   auto pipeline = nebula::ZProtoPipeline::create();
   pipeline->addBack(wangle::AsyncSocketHandler(sock));
+  if (nebula::ConnFlowControlHandler::IsEnabled(service_->GetServiceConfig())) {
+    pipeline->addBack(nebula::ConnFlowControlHandler(service_->GetServiceConfig()));
+  }
   pipeline->addBack(wangle::EventBaseHandler()); // ensure we can write from any thread
   pipeline->addBack(ZProtoFrameDecoder());
   pipeline->addBack(ZProtoFrameHandler());
@@ -62,6 +66,9 @@ nebula::ZProtoPipeline::Ptr ZProtoClientPipelineFactory::newPipeline(std::shared
   pipeline->setTransportInfo(transportInfo);
   
   pipeline->addBack(wangle::AsyncSocketHandler(sock));
+  if (nebula::ConnFlowControlHandler::IsEnabled(service_->GetServiceConfig())) {
+    pipeline->addBack(nebula::ConnFlowControlHandler(service_->GetServiceConfig()));
+  }
   pipeline->addBack(wangle::EventBaseHandler()); // ensure we can write from any thread
   pipeline->addBack(ZProtoFrameDecoder());
   pipeline->addBack(ZProtoFrameHandler());
@@ -77,6 +84,9 @@ nebula::ZProtoPipeline::Ptr ZProtoServerPipelineFactory::newPipeline(std::shared
   auto pipeline = nebula::ZProtoPipeline::create();
   pipeline->setReadBufferSettings(kDefaultMinAvailable, kDefaultAllocationSize);
   pipeline->addBack(wangle::AsyncSocketHandler(sock));
+  if (nebula::ConnFlowControlHandler::IsEnabled(service_->GetServiceConfig())) {
+    pipeline->addBack(nebula::ConnFlowControlHandler(service_->GetServiceConfig()));
+  }
   pipeline->addBack(ZProtoFrameDecoder());
   pipeline->addBack(ZProtoFrameHandler());
   pipeline->addBack(ZProtoPackageHandler());
@@ -22,6 +22,7 @@
 
 // #include "nebula/net/base/service_factory_manager.h"
 #include "nebula/net/thread_local_conn_manager.h"
+#include "nebula/net/engine/tcp_service_base.h"
 
 //#include "nebula/net/server/tcp_client_group.h"
 //#include "nebula/net/server/tcp_server.h"
@@ -148,6 +149,48 @@ bool NetEngineManager::Stop() {
   return true;
 }
 
+namespace {
+
+inline bool IsListenService(const ServiceBasePtr& service) {
+  auto type = service->GetModuleType();
+  return type == ServiceModuleType::TCP_SERVER || type == ServiceModuleType::RPC_SERVER;
+}
+
+}
+
+ListenFdList NetEngineManager::GetListenFds() const {
+  ListenFdList fds;
+  for (auto& v : services_) {
+    if (!IsListenService(v.second)) {
+      continue;
+    }
+    std::vector<int> service_fds;
+    std::static_pointer_cast<TcpServiceBase>(v.second)->GetListenFds(&service_fds);
+    for (auto fd : service_fds) {
+      fds.push_back(std::make_pair(v.first, fd));
+    }
+  }
+  return fds;
+}
+
+void NetEngineManager::StopAccepting() {
+  for (auto& v : services_) {
+    if (IsListenService(v.second)) {
+      std::static_pointer_cast<TcpServiceBase>(v.second)->StopAccepting();
+    }
+  }
+}
+
+size_t NetEngineManager::GetServerConnCount() const {
+  size_t count = 0;
+  for (auto& v : services_) {
+    if (IsListenService(v.second)) {
+      count += std::static_pointer_cast<TcpServiceBase>(v.second)->GetConnCount();
+    }
+  }
+  return count;
+}
+
 // 查找分组
 std::shared_ptr<ServiceBase> NetEngineManager::Lookup(const std::string& service_name) {
   std::shared_ptr<ServiceBase> service;
@@ -26,6 +26,7 @@
 #include "nebula/base/configuration.h"
 
 #include "nebula/net/thread_group_list_manager.h"
+#include "nebula/net/base/socket_handoff.h"
 #include "nebula/net/base/service_base.h"
 
 namespace nebula {
@@ -57,6 +58,14 @@ public :
   bool Start();
   bool Pause();
   bool Stop();
+  
+  // 平滑重启
+  // 所有tcp_server/rpc_server的监听fd
+  ListenFdList GetListenFds() const;
+  // 所有tcp_server/rpc_server停止accept
+  void StopAccepting();
+  // 所有tcp_server/rpc_server的连接数
+  size_t GetServerConnCount() const;
     
   folly::EventBase* GetEventBaseByThreadType(ThreadType thread_type) const {
     return thread_groups_->GetEventBaseByThreadType(thread_type);
@@ -71,7 +80,7 @@ public :
   }
   
   ThreadGroupPtr GetThreadGroupByThreadType(ThreadType thread_type) const {
-    return thread_groups_->GetThreadGroupByThreadType(thread_type);
+    return thread_groups_ ? thread_groups_->GetThreadGroupByThreadType(thread_type) : nullptr;
   }
   
   ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/rpc/zrpc_admission.h"
+
+#include "nebula/net/rpc/zrpc_method_table.h"
+
+ZRpcAdmission::ZRpcAdmission(const ZRpcMethodOption& option)
+  : max_in_flight_(option.max_in_flight),
+    max_queue_size_(option.max_queue_size),
+    codel_target_us_(static_cast<uint64_t>(option.codel_target_ms) * 1000),
+    codel_interval_us_(static_cast<uint64_t>(option.codel_interval_ms) * 1000) {
+}
+
+bool ZRpcAdmission::Admit(bool queued) {
+  auto in_flight = in_flight_.fetch_add(1, std::memory_order_relaxed);
+  if (max_in_flight_ > 0 && in_flight >= max_in_flight_) {
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+  
+  if (!queued) {
+    return true;
+  }
+  
+  if (codel_target_us_ > 0 && overloaded_.load(std::memory_order_relaxed)) {
+    if (queue_size_.load(std::memory_order_relaxed) > 0) {
+      in_flight_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    // 队列已排空, 退出过载
+    first_above_time_.store(0, std::memory_order_relaxed);
+    overloaded_.store(false, std::memory_order_relaxed);
+  }
+  
+  auto queue_size = queue_size_.fetch_add(1, std::memory_order_relaxed);
+  if (max_queue_size_ > 0 && queue_size >= max_queue_size_) {
+    queue_size_.fetch_sub(1, std::memory_order_relaxed);
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+  
+  return true;
+}
+
+void ZRpcAdmission::OnDequeue(uint64_t sojourn_us, uint64_t now_us) {
+  queue_size_.fetch_sub(1, std::memory_order_relaxed);
+  
+  if (codel_target_us_ == 0) {
+    return;
+  }
+  
+  if (sojourn_us < codel_target_us_) {
+    first_above_time_.store(0, std::memory_order_relaxed);
+    if (overloaded_.load(std::memory_order_relaxed)) {
+      overloaded_.store(false, std::memory_order_relaxed);
+    }
+    return;
+  }
+  
+  auto first_above_time = first_above_time_.load(std::memory_order_relaxed);
+  if (first_above_time == 0) {
+    first_above_time_.compare_exchange_strong(first_above_time,
+                                              now_us + codel_interval_us_,
+                                              std::memory_order_relaxed);
+  } else if (now_us >= first_above_time && !overloaded_.load(std::memory_order_relaxed)) {
+    overloaded_.store(true, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,79 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_RPC_ZRPC_ADMISSION_H_
+#define NEBULA_NET_RPC_ZRPC_ADMISSION_H_
+
+#include <atomic>
+#include <cstdint>
+
+struct ZRpcMethodOption;
+
+// 服务端每个方法的准入控制
+//  1. 并发(已接收还未应答)上限
+//  2. 投递到线程组的排队上限
+//  3. CoDel: 排队延时在一个interval内始终高于target则认为过载，
+//     过载期间新请求直接拒绝，直到排队延时回落或队列排空
+// 被拒绝的请求由调用方返回RpcFloodWait
+class ZRpcAdmission {
+public:
+  explicit ZRpcAdmission(const ZRpcMethodOption& option);
+  
+  // queued: 是否需要投递到线程组排队
+  // 返回false则拒绝该请求
+  bool Admit(bool queued);
+  
+  // 投递的请求开始执行, sojourn_us为排队时间
+  void OnDequeue(uint64_t sojourn_us, uint64_t now_us);
+  
+  // 投递失败(线程组拒绝), 请求没有出队执行
+  void OnDropped() {
+    queue_size_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  
+  // 请求完成(包括被拒绝以外的所有请求)
+  void OnComplete() {
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  
+  bool overloaded() const {
+    return overloaded_.load(std::memory_order_relaxed);
+  }
+  
+  uint32_t in_flight() const {
+    return in_flight_.load(std::memory_order_relaxed);
+  }
+  
+  uint32_t queue_size() const {
+    return queue_size_.load(std::memory_order_relaxed);
+  }
+  
+private:
+  const uint32_t max_in_flight_;
+  const uint32_t max_queue_size_;
+  const uint64_t codel_target_us_;
+  const uint64_t codel_interval_us_;
+  
+  std::atomic<uint32_t> in_flight_ {0};
+  std::atomic<uint32_t> queue_size_ {0};
+  
+  // 排队延时第一次超过target后, 持续到该时间点则进入过载
+  std::atomic<uint64_t> first_above_time_ {0};
+  std::atomic<bool> overloaded_ {false};
+};
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/rpc/zrpc_batch_writer.h"
+
+ZRpcBatchWriter::ZRpcBatchWriter(folly::EventBase* evb, uint32_t max_count, uint32_t window_ms, WriteFunc f)
+  : folly::AsyncTimeout(evb),
+    evb_(evb),
+    max_count_(max_count),
+    window_ms_(window_ms),
+    write_func_(f),
+    promise_(std::make_shared<folly::SharedPromise<folly::Unit>>()) {
+}
+
+folly::Future<folly::Unit> ZRpcBatchWriter::Write(PackageMessagePtr message) {
+  batch_.push_back(message);
+  auto f = promise_->getFuture();
+  
+  if (batch_.size() >= max_count_) {
+    Flush();
+  } else if (window_ms_ > 0) {
+    if (!isScheduled()) {
+      scheduleTimeout(window_ms_);
+    }
+  } else if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+  
+  return f;
+}
+
+void ZRpcBatchWriter::Flush() {
+  cancelLoopCallback();
+  cancelTimeout();
+  
+  if (batch_.empty()) {
+    return;
+  }
+  
+  std::unique_ptr<folly::IOBuf> out;
+  if (batch_.size() == 1) {
+    batch_.front()->SerializeToIOBuf(out);
+  } else {
+    Container container;
+    container.data.swap(batch_);
+    container.SerializeToIOBuf(out);
+  }
+  batch_.clear();
+  
+  auto promise = std::move(promise_);
+  promise_ = std::make_shared<folly::SharedPromise<folly::Unit>>();
+  write_func_(std::move(out)).then([promise](folly::Try<folly::Unit>&& t) {
+    promise->setTry(std::move(t));
+  });
+}
+
+size_t ZRpcBatchWriter::Fail(const folly::exception_wrapper& ew) {
+  cancelLoopCallback();
+  cancelTimeout();
+  
+  auto count = batch_.size();
+  batch_.clear();
+  
+  auto promise = std::move(promise_);
+  promise_ = std::make_shared<folly::SharedPromise<folly::Unit>>();
+  promise->setException(ew);
+  return count;
+}
@@ -0,0 +1,63 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_RPC_ZRPC_BATCH_WRITER_H_
+#define NEBULA_NET_RPC_ZRPC_BATCH_WRITER_H_
+
+#include <folly/futures/SharedPromise.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+
+#include "nebula/net/zproto/zproto_package_data.h"
+
+// 批量写
+// 同一次事件循环(或window_ms窗口)里写的多个包打包成一个Container一次写出,
+// 省去每个包的frame头、pipeline遍历和系统调用
+// 只能在连接所在的IO线程里使用
+class ZRpcBatchWriter : private folly::EventBase::LoopCallback, private folly::AsyncTimeout {
+public:
+  using WriteFunc = std::function<folly::Future<folly::Unit>(std::unique_ptr<folly::IOBuf>)>;
+  
+  // max_count: 攒够max_count个包立即写出
+  // window_ms: 为0时在本次事件循环结束时写出, 否则等待window_ms
+  ZRpcBatchWriter(folly::EventBase* evb, uint32_t max_count, uint32_t window_ms, WriteFunc f);
+  ~ZRpcBatchWriter() override = default;
+  
+  folly::Future<folly::Unit> Write(PackageMessagePtr message);
+  void Flush();
+  // 连接已断开: 丢弃还没写出的包, 等待这批写完成的调用方收到异常, 返回丢弃的包数
+  size_t Fail(const folly::exception_wrapper& ew);
+  
+private:
+  void runLoopCallback() noexcept override {
+    Flush();
+  }
+  
+  void timeoutExpired() noexcept override {
+    Flush();
+  }
+  
+  folly::EventBase* evb_;
+  uint32_t max_count_;
+  uint32_t window_ms_;
+  WriteFunc write_func_;
+  
+  std::list<PackageMessagePtr> batch_;
+  std::shared_ptr<folly::SharedPromise<folly::Unit>> promise_;
+};
+
+#endif
@@ -17,39 +17,164 @@
 
 #include "nebula/net/rpc/zrpc_client_dispatcher.h"
 
-#include "nebula/base/id_util.h"
+#include "nebula/net/rpc/zrpc_latency_stats.h"
+
+ZRpcMultiplexClientDispatcher::ZRpcMultiplexClientDispatcher(const std::string& backend)
+  : backend_id_(ZRpcLatencyStats::GetInstance().GetBackendID(backend)),
+    pending_(kInitialPendingSlots) {
+}
+
+ZRpcMultiplexClientDispatcher::PendingRequest* ZRpcMultiplexClientDispatcher::AllocPending() {
+  if (pending_count_ == pending_.size()) {
+    GrowPending();
+  }
+  
+  // 槽位被更早的慢请求占用时跳过这个id, id仍然递增
+  auto mask = pending_.size() - 1;
+  for (;;) {
+    auto message_id = next_message_id_++;
+    auto& pending = pending_[message_id & mask];
+    if (pending.message_id == 0) {
+      pending.message_id = message_id;
+      ++pending_count_;
+      return &pending;
+    }
+  }
+}
+
+ZRpcMultiplexClientDispatcher::PendingRequest* ZRpcMultiplexClientDispatcher::FindPending(int64_t message_id) {
+  if (message_id <= 0) {
+    return nullptr;
+  }
+  auto& pending = pending_[message_id & (pending_.size() - 1)];
+  return pending.message_id == message_id ? &pending : nullptr;
+}
+
+void ZRpcMultiplexClientDispatcher::GrowPending() {
+  // 扩容一倍: 原表里各个id的低位互不相同, 在新表里也不会冲突
+  auto size = pending_.size() * 2;
+  std::vector<PendingRequest> pending(size);
+  for (auto& v : pending_) {
+    if (v.message_id != 0) {
+      pending[v.message_id & (size - 1)] = std::move(v);
+    }
+  }
+  pending_.swap(pending);
+  
+  LOG(WARNING) << "GrowPending - pending slots: " << pending_.size() << ", backend_id: " << backend_id_;
+}
+
+ZRpcMultiplexClientDispatcher::PendingRequest ZRpcMultiplexClientDispatcher::TakePending(PendingRequest* pending) {
+  PendingRequest v = std::move(*pending);
+  pending->message_id = 0;
+  --pending_count_;
+  return v;
+}
+
+void ZRpcMultiplexClientDispatcher::Complete(PendingRequest& pending, ProtoRpcResponsePtr rsp) {
+  // 应答里是连接内的id, 换回调用方请求的id
+  rsp->req_message_id = pending.req_message_id;
+  ZRpcLatencyStats::GetInstance().Record(ZRpcSide::CLIENT,
+                                         pending.method_id,
+                                         backend_id_,
+                                         rsp->GetPackageType(),
+                                         ZRpcLatencyStats::NowInUsec() - pending.start_time);
+  pending.promise->setValue(rsp);
+}
 
 void ZRpcMultiplexClientDispatcher::read(Context* ctx, ProtoRpcResponsePtr in) {
   LOG(INFO) << "read - " << in->ToString();
   
-  auto it = requests_.find(in->req_message_id);
-  // CHECK(search != requests_.end());
-
-  if (it == requests_.end()) {
+  if (!streams_.empty()) {
+    auto it2 = streams_.find(in->req_message_id);
+    if (it2 != streams_.end()) {
+      if (in->GetPackageType() == Package::RPC_STREAM_PUSH) {
+        it2->second->OnPush(in);
+      } else {
+        // 结束包
+        auto stream = std::move(it2->second);
+        streams_.erase(it2);
+        stream->OnFinish(in);
+      }
+      return;
+    }
+  }
+  
+  auto pending = FindPending(in->req_message_id);
+  if (!pending) {
     LOG(ERROR) << "read - not find req's req_message_id: " << in->req_message_id;
   } else {
-    auto p = std::move(it->second);
-    requests_.erase(in->req_message_id);
-    p.setValue(in);
+    // 先置空槽位再完成, 回调里可能发起新请求
+    auto v = TakePending(pending);
+    Complete(v, in);
   }
 }
 
 folly::Future<ProtoRpcResponsePtr> ZRpcMultiplexClientDispatcher::operator()(RpcRequestPtr arg) {
-  auto& p = requests_[arg->message_id()];
-  auto f = p.getFuture();
-  p.setInterruptHandler([arg, this, &p](const folly::exception_wrapper& e) {
+  // 请求id在连接内分配, 只设置在发送用的副本上
+  auto send = MakeSendRequest(arg);
+  auto pending = AllocPending();
+  auto message_id = pending->message_id;
+  send->set_message_id(message_id);
+  pending->req_message_id = arg->message_id();
+  pending->method_id = arg->method_id;
+  pending->start_time = ZRpcLatencyStats::NowInUsec();
+  pending->promise.emplace();
+  
+  auto f = pending->promise->getFuture();
+  pending->promise->setInterruptHandler([message_id, this](const folly::exception_wrapper& e) {
     // 超时
     LOG(INFO) << "setInterruptHandler: " << folly::exceptionStr(e);
-    auto rpc_error = std::make_shared<RpcInternalError>(arg->message_id());
-    // rpc_error->set_req_message_id(arg->message_id());
-    p.setValue(rpc_error);
-    this->requests_.erase(arg->message_id());
+    auto pending = this->FindPending(message_id);
+    if (pending) {
+      auto v = this->TakePending(pending);
+      this->Complete(v, std::make_shared<RpcInternalError>(message_id));
+    }
   });
 
-  this->pipeline_->write(arg);
+  this->pipeline_->write(send);
   return f;
 }
 
+ZRpcClientStreamPtr ZRpcMultiplexClientDispatcher::StreamCall(RpcRequestPtr arg) {
+  // 和普通请求共用连接内的id序列, 不占用未完成请求表
+  auto send = MakeSendRequest(arg);
+  auto message_id = next_message_id_++;
+  send->set_message_id(message_id);
+  
+  // dispatcher可能先于流释放, 补充credit时切回IO线程并检查dispatcher是否还在
+  std::weak_ptr<ZRpcMultiplexClientDispatcher> self = shared_from_this();
+  auto evb = this->pipeline_->getTransport()->getEventBase();
+  auto stream = std::make_shared<ZRpcClientStream>(message_id,
+                                                   RpcStreamCredit::kDefaultStreamWindow,
+                                                   [self, evb, message_id](uint32_t credits) {
+    evb->runInEventBaseThread([self, message_id, credits]() {
+      auto dispatcher = self.lock();
+      if (dispatcher) {
+        dispatcher->SendCredits(message_id, credits);
+      }
+    });
+  });
+  
+  streams_[message_id] = stream;
+  this->pipeline_->write(send);
+  return stream;
+}
+
+RpcRequestPtr ZRpcMultiplexClientDispatcher::MakeSendRequest(const RpcRequestPtr& arg) {
+  // 调用方的请求可能同时发给多个连接(对冲、并发扇出), 或者还在别的线程里被读取, 不能修改
+  // 不支持Clone的请求直接发送, 这种请求不能共用
+  auto send = arg->Clone();
+  return send ? send : arg;
+}
+
+void ZRpcMultiplexClientDispatcher::SendCredits(int64_t req_message_id, uint32_t credits) {
+  if (streams_.find(req_message_id) == streams_.end()) {
+    return;
+  }
+  this->pipeline_->write(std::make_shared<RpcStreamCredit>(req_message_id, credits));
+}
+
 // Print some nice messages for close
 
 folly::Future<folly::Unit> ZRpcMultiplexClientDispatcher::close() {
@@ -64,21 +189,42 @@ folly::Future<folly::Unit> ZRpcMultiplexClientDispatcher::close(Context* ctx) {
 
 // 网络断开等
 void ZRpcMultiplexClientDispatcher::Clear() {
-  auto rpc_error = std::make_shared<RpcInternalError>(0);
-  for (auto it=requests_.begin(); it!=requests_.end(); ++it) {
-    it->second.setValue(rpc_error);
+  std::vector<PendingRequest> requests;
+  for (auto& v : pending_) {
+    if (v.message_id != 0) {
+      requests.push_back(TakePending(&v));
+    }
+  }
+  for (auto& v : requests) {
+    Complete(v, std::make_shared<RpcInternalError>(v.req_message_id));
   }
   
-  requests_.clear();
+  auto streams = std::move(streams_);
+  streams_.clear();
+  for (auto& v : streams) {
+    v.second->OnFinish(std::make_shared<RpcInternalError>(v.first));
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 folly::Future<ProtoRpcResponsePtr> ZRpcClientFilter::operator()(RpcRequestPtr req) {
-  // TODO(@benqi): 共享包
-  if (req->message_id()==0) {
-    req->set_message_id(GetNextIDBySnowflake());
+  // message_id由dispatcher在连接内分配
+  
+  // 对端过载, 退避期间不再发送, 由上层换连接或稍后重试
+  auto remaining = flood_wait_->GetRemaining(req->method_id);
+  if (remaining > 0) {
+    return folly::makeFuture<ProtoRpcResponsePtr>(
+        std::make_shared<RpcFloodWait>(req->message_id(), static_cast<int32_t>((remaining + 999) / 1000)));
   }
-  return (*this->service_)(std::move(req));
+  
+  auto flood_wait = flood_wait_;
+  auto method_id = req->method_id;
+  return (*this->service_)(std::move(req)).then([flood_wait, method_id](ProtoRpcResponsePtr rsp) {
+    if (rsp->GetPackageType() == Package::RPC_FLOOD_WAIT) {
+      flood_wait->Set(method_id, std::static_pointer_cast<RpcFloodWait>(rsp)->delay);
+    }
+    return rsp;
+  });
 //  auto p = std::make_shared<folly::Promise<ProtoRpcResponsePtr>>();// p;
 //  auto f = p->getFuture();
 //  (*this->service_)(req)
@@ -18,10 +18,19 @@
 #ifndef NEBULA_NET_RPC_ZRPC_CLIENT_DISPATCHER_H_
 #define NEBULA_NET_RPC_ZRPC_CLIENT_DISPATCHER_H_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/Optional.h>
+#include <folly/SharedMutex.h>
 #include <wangle/service/ClientDispatcher.h>
 #include <wangle/channel/Handler.h>
 
 #include "nebula/net/zproto/zproto_package_data.h"
+#include "nebula/net/rpc/zrpc_stream.h"
 
 // #include "nebula/net/rpc/zrpc_client_handler.h"
 
@@ -29,8 +38,12 @@ using ZRpcClientPipeline = wangle::Pipeline<folly::IOBufQueue&, RpcRequestPtr>;
 
 // Client multiplex dispatcher.  Uses Bonk.type as request ID
 class ZRpcMultiplexClientDispatcher : public wangle::ClientDispatcherBase<
-    ZRpcClientPipeline, RpcRequestPtr, ProtoRpcResponsePtr> {
+    ZRpcClientPipeline, RpcRequestPtr, ProtoRpcResponsePtr>,
+    public std::enable_shared_from_this<ZRpcMultiplexClientDispatcher> {
 public:
+  // backend: 对端地址, 用于延时统计
+  explicit ZRpcMultiplexClientDispatcher(const std::string& backend = "");
+  
   ~ZRpcMultiplexClientDispatcher() {
     Clear();
     
@@ -41,6 +54,9 @@ public:
   void read(Context* ctx, ProtoRpcResponsePtr in) override;
 
   folly::Future<ProtoRpcResponsePtr> operator()(RpcRequestPtr arg) override;
+  
+  // 流式调用, 必须在IO线程里调用
+  ZRpcClientStreamPtr StreamCall(RpcRequestPtr arg);
 
   // Print some nice messages for close
   virtual folly::Future<folly::Unit> close() override;
@@ -49,14 +65,100 @@ public:
   void Clear();
   
 private:
-  std::unordered_map<int64_t, folly::Promise<ProtoRpcResponsePtr>> requests_;
+  // 未完成请求表的初始槽数, 必须为2的幂
+  static const uint32_t kInitialPendingSlots = 1024;
+  
+  // 请求id为连接内递增的序号, 槽位为id & (slots - 1), 完成后槽位复用
+  // 只在连接所在的IO线程里访问
+  struct PendingRequest {
+    int64_t message_id {0};   // 0为空槽
+    int64_t req_message_id {0};   // 调用方请求的message_id, 应答时换回
+    int method_id {0};
+    uint64_t start_time {0};
+    folly::Optional<folly::Promise<ProtoRpcResponsePtr>> promise;
+  };
+  
+  // 分配请求id和槽位, 槽位都被占用时扩容
+  PendingRequest* AllocPending();
+  PendingRequest* FindPending(int64_t message_id);
+  void GrowPending();
+  
+  // 取出请求, 槽位置空
+  PendingRequest TakePending(PendingRequest* pending);
+  // 完成请求并记录延时
+  void Complete(PendingRequest& pending, ProtoRpcResponsePtr rsp);
+  
+  // 发送用的请求副本, 连接内的id只设置在副本上
+  RpcRequestPtr MakeSendRequest(const RpcRequestPtr& arg);
+  void SendCredits(int64_t req_message_id, uint32_t credits);
+  
+  uint32_t backend_id_ {0};
+  
+  int64_t next_message_id_ {1};
+  std::vector<PendingRequest> pending_;
+  uint32_t pending_count_ {0};
+  
+  std::unordered_map<int64_t, ZRpcClientStreamPtr> streams_;
+};
+
+// 对端返回RpcFloodWait后的退避状态, 按method_id退避
+// (服务端的准入控制和限流都是按方法的, 一个方法过载不影响同一连接上的其它方法)
+// 在连接所在的IO线程里写, 选连接时在任意线程里读
+class ZRpcFloodWaitState {
+public:
+  static int64_t NowInMsec() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+  
+  // delay单位为秒
+  void Set(int32_t method_id, int32_t delay) {
+    auto now = NowInMsec();
+    auto until = now + static_cast<int64_t>(std::max(delay, 1)) * 1000;
+    {
+      folly::SharedMutex::WriteHolder g(lock_);
+      // 顺便清掉已过期的
+      for (auto it = until_ms_.begin(); it != until_ms_.end();) {
+        it = it->second <= now ? until_ms_.erase(it) : std::next(it);
+      }
+      until_ms_[method_id] = until;
+    }
+    // 只有IO线程写
+    if (until > max_until_ms_.load(std::memory_order_relaxed)) {
+      max_until_ms_.store(until, std::memory_order_relaxed);
+    }
+  }
+  
+  // 剩余退避时间(毫秒), 0为未退避
+  int64_t GetRemaining(int32_t method_id) const {
+    auto now = NowInMsec();
+    // 绝大部分时间没有方法在退避, 不加锁
+    if (max_until_ms_.load(std::memory_order_relaxed) <= now) {
+      return 0;
+    }
+    
+    folly::SharedMutex::ReadHolder g(lock_);
+    auto it = until_ms_.find(method_id);
+    if (it == until_ms_.end() || it->second <= now) {
+      return 0;
+    }
+    return it->second - now;
+  }
+  
+private:
+  mutable folly::SharedMutex lock_;
+  std::unordered_map<int32_t, int64_t> until_ms_;
+  // 所有方法里最晚的退避结束时间
+  std::atomic<int64_t> max_until_ms_ {0};
 };
 
 // template <typename Req, typename Resp = Req>
 class ZRpcClientFilter : public wangle::ServiceFilter<RpcRequestPtr, ProtoRpcResponsePtr> {
 public:
-  explicit ZRpcClientFilter(std::shared_ptr<wangle::Service<RpcRequestPtr, ProtoRpcResponsePtr>> service)
-    : ServiceFilter<RpcRequestPtr, ProtoRpcResponsePtr>(service) {}
+  ZRpcClientFilter(std::shared_ptr<wangle::Service<RpcRequestPtr, ProtoRpcResponsePtr>> service,
+                   std::shared_ptr<ZRpcFloodWaitState> flood_wait)
+    : ServiceFilter<RpcRequestPtr, ProtoRpcResponsePtr>(service),
+      flood_wait_(flood_wait) {}
   
   ~ZRpcClientFilter() {
   }
@@ -66,6 +168,9 @@ public:
 //  }
   
   virtual folly::Future<ProtoRpcResponsePtr> operator()(RpcRequestPtr req) override;
+  
+private:
+  std::shared_ptr<ZRpcFloodWaitState> flood_wait_;
 };
 
 #endif
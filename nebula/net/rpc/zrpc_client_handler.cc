@@ -19,13 +19,28 @@
 
 #include <folly/MoveWrapper.h>
 
+#include "nebula/net/base/socket_address_util.h"
+
 void ZRpcClientHandler::read(Context* ctx, PackageMessagePtr msg) {
   LOG(INFO) << "read - received data: " << msg->ToString();
+  if (msg->GetPackageType() == Package::CONTAINER) {
+    // 服务端批量返回的应答
+    auto container = std::static_pointer_cast<Container>(msg);
+    for (auto& v : container->data) {
+      ctx->fireRead(std::static_pointer_cast<ProtoRpcResponse>(v));
+    }
+    return;
+  }
+  
   auto received = std::static_pointer_cast<ProtoRpcResponse>(msg);
   ctx->fireRead(received);
 }
 
 folly::Future<folly::Unit> ZRpcClientHandler::write(Context* ctx, RpcRequestPtr req) {
+  if (batch_writer_) {
+    return batch_writer_->Write(req);
+  }
+  
   std::unique_ptr<folly::IOBuf> (out);
   req->SerializeToIOBuf((out));
   return ctx->fireWrite(std::move(out));
@@ -48,23 +63,45 @@ void ZRpcClientHandler::readException(Context* ctx, folly::exception_wrapper e)
 
 void ZRpcClientHandler::transportActive(Context* ctx) {
   auto pipeline = dynamic_cast<ZRpcClientPipeline*>(ctx->getPipeline());
-  OnNewConnection(pipeline, pipeline->getTransportInfo()->remoteAddr->getAddressStr());
+  OnNewConnection(pipeline, nebula::ToAddressString(*pipeline->getTransportInfo()->remoteAddr));
   
   LOG(INFO) << "transportActive - conn_id = " << conn_id_
               << ", Connection connected by "
               << remote_address_
               << ", conn_info: " << service_->GetServiceConfig().ToString();
  
-  auto dispatcher = std::make_shared<ZRpcMultiplexClientDispatcher>();
-  dispatcher->setPipeline(pipeline);
-  rpc_service_ = std::make_shared<ZRpcClientFilter>(dispatcher);
+  evb_ = ctx->getTransport()->getEventBase();
+  dispatcher_ = std::make_shared<ZRpcMultiplexClientDispatcher>(remote_address_);
+  dispatcher_->setPipeline(pipeline);
+  rpc_service_ = std::make_shared<ZRpcClientFilter>(dispatcher_, flood_wait_);
+  
+  auto& config = service_->GetServiceConfig();
+  if (config.batch_max_count > 1) {
+    batch_writer_.reset(new ZRpcBatchWriter(evb_, config.batch_max_count, config.batch_window_ms,
+                                            [ctx](std::unique_ptr<folly::IOBuf> out) {
+                                              return ctx->fireWrite(std::move(out));
+                                            }));
+  }
 }
 
 void ZRpcClientHandler::transportInactive(Context* ctx) {
   if (conn_state_ != ConnState::CONNECTED) {
     return;
   }
+  // 批量写里还没写出的请求不会再发出去, 先让写失败, 再由Clear给所有未完成的请求应答RpcInternalError
+  if (batch_writer_) {
+    auto count = batch_writer_->Fail(
+        folly::make_exception_wrapper<std::runtime_error>("transportInactive - connection closed"));
+    if (count > 0) {
+      LOG(WARNING) << "transportInactive - conn_id = " << conn_id_ << ", drop unflushed requests: " << count;
+    }
+    batch_writer_.reset();
+  }
+  if (dispatcher_) {
+    dispatcher_->Clear();
+  }
   rpc_service_.reset();
+  dispatcher_.reset();
   LOG(INFO) << "transportInactive - conn_id = " << conn_id_
               << ", Connection closed by "
               << remote_address_
@@ -80,7 +117,17 @@ void ZRpcClientHandler::transportInactive(Context* ctx) {
 
 folly::Future<ProtoRpcResponsePtr> ZRpcClientHandler::ServiceCall(RpcRequestPtr arg) {
   // TODO(@benqi): 同步等...
-  // return (*rpc_service_)(arg);
+  if (!rpc_service_) {
+    LOG(ERROR) << "ServiceCall - conn_id = " << conn_id_ << " closed, by " << remote_address_;
+    return folly::makeFuture<ProtoRpcResponsePtr>(std::make_shared<RpcInternalError>(arg->message_id()));
+  }
   return (*rpc_service_)(arg);
 }
 
+ZRpcClientStreamPtr ZRpcClientHandler::StreamCall(RpcRequestPtr arg) {
+  if (!dispatcher_) {
+    LOG(ERROR) << "StreamCall - conn_id = " << conn_id_ << " closed, by " << remote_address_;
+    return nullptr;
+  }
+  return dispatcher_->StreamCall(arg);
+}
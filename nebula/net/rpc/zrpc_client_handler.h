@@ -20,6 +20,7 @@
 
 #include "nebula/net/handler/nebula_base_handler.h"
 #include "nebula/net/rpc/zrpc_client_dispatcher.h"
+#include "nebula/net/rpc/zrpc_batch_writer.h"
 
 #include <wangle/service/ExpiringFilter.h>
 
@@ -29,7 +30,8 @@ class ZRpcClientHandler : public nebula::NebulaBaseHandler, public wangle::Handl
   RpcRequestPtr, std::unique_ptr<folly::IOBuf>> {
 public:
   explicit ZRpcClientHandler(nebula::ServiceBase* service)
-    : NebulaBaseHandler(service) {}
+    : NebulaBaseHandler(service),
+      flood_wait_(std::make_shared<ZRpcFloodWaitState>()) {}
 
   virtual void read(Context* ctx, PackageMessagePtr msg) override;
 
@@ -43,11 +45,27 @@ public:
 
   // virtual folly::Future<folly::Unit> close(Context* ctx) override;
 
+  // 必须在连接所在的IO线程里调用
   folly::Future<ProtoRpcResponsePtr> ServiceCall(RpcRequestPtr arg);
+  // 流式调用, 必须在连接所在的IO线程里调用, 连接已断开返回nullptr
+  ZRpcClientStreamPtr StreamCall(RpcRequestPtr arg);
+  
+  folly::EventBase* GetEventBase() const {
+    return evb_;
+  }
+  
+  // 对端对method_id返回RpcFloodWait后的退避期间, 线程安全
+  bool IsFloodWaiting(int32_t method_id) const {
+    return flood_wait_->GetRemaining(method_id) > 0;
+  }
 
 protected:
-    // std::shared_ptr<ZRpcMultiplexClientDispatcher> dispatcher_;
+    folly::EventBase* evb_ {nullptr};
+    std::shared_ptr<ZRpcFloodWaitState> flood_wait_;
+    std::shared_ptr<ZRpcMultiplexClientDispatcher> dispatcher_;
     std::shared_ptr<ZRpcClientFilter> rpc_service_;
+    // 配置了batch_max_count才启用
+    std::unique_ptr<ZRpcBatchWriter> batch_writer_;
 };
 
 #endif
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/rpc/zrpc_client_policy.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "nebula/net/rpc/zrpc_latency_stats.h"
+
+// 对冲延时刷新周期
+const uint64_t kHedgeDelayRefreshUsec = 1000000;
+
+uint64_t ZRpcClientMethodEntry::GetHedgeDelay() const {
+  auto now = ZRpcLatencyStats::NowInUsec();
+  auto last = hedge_delay_update_us.load(std::memory_order_relaxed);
+  if (now - last >= kHedgeDelayRefreshUsec &&
+      hedge_delay_update_us.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+    // 只有一个线程刷新, 其它线程继续用旧值
+    auto p95 = ZRpcLatencyStats::GetInstance().GetMethodPercentile(ZRpcSide::CLIENT, method_id, 95);
+    uint64_t min_us = option.hedge_min_delay_ms * 1000ULL;
+    uint64_t max_us = option.hedge_max_delay_ms * 1000ULL;
+    auto delay = p95 == 0 ? max_us : std::max(min_us, std::min(p95, max_us));
+    hedge_delay_us.store(delay, std::memory_order_relaxed);
+    return delay;
+  }
+  
+  return hedge_delay_us.load(std::memory_order_relaxed);
+}
+
+ZRpcClientMethodTable& ZRpcClientMethodTable::GetInstance() {
+  static ZRpcClientMethodTable g_client_method_table;
+  return g_client_method_table;
+}
+
+bool ZRpcClientMethodTable::Register(int method_id, const ZRpcClientMethodOption& option) {
+  std::lock_guard<std::mutex> g(mutex_);
+  
+  if (frozen_.load(std::memory_order_relaxed)) {
+    LOG(ERROR) << "Register - client method table frozen, method_id: " << method_id;
+    return false;
+  }
+  
+  if (entries_.find(method_id) != entries_.end()) {
+    LOG(ERROR) << "Register - duplicate client entry for method_id: " << method_id;
+    return false;
+  }
+  
+  std::unique_ptr<ZRpcClientMethodEntry> entry(new ZRpcClientMethodEntry());
+  entry->method_id = method_id;
+  entry->option = option;
+  if (entry->option.hedge && !entry->option.idempotent) {
+    LOG(WARNING) << "Register - hedge requires idempotent, method_id: " << method_id;
+    entry->option.hedge = false;
+  }
+  entries_.emplace(method_id, std::move(entry));
+  return true;
+}
+
+ZRpcRetryBudget& ZRpcRetryBudget::GetInstance() {
+  static ZRpcRetryBudget g_retry_budget;
+  return g_retry_budget;
+}
+
+void ZRpcRetryBudget::SetConf(double ratio, uint32_t max_tokens) {
+  deposit_ = static_cast<int64_t>(ratio * kTokenScale);
+  max_tokens_ = static_cast<int64_t>(max_tokens) * kTokenScale;
+}
+
+void ZRpcRetryBudget::OnRequest() {
+  // 超过上限时多存的部分可以丢弃, 不需要严格
+  if (tokens_.load(std::memory_order_relaxed) < max_tokens_) {
+    tokens_.fetch_add(deposit_, std::memory_order_relaxed);
+  }
+}
+
+bool ZRpcRetryBudget::TryRetry() {
+  auto v = tokens_.load(std::memory_order_relaxed);
+  while (v >= kTokenScale) {
+    if (tokens_.compare_exchange_weak(v, v - kTokenScale, std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
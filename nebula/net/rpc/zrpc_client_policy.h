@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_RPC_ZRPC_CLIENT_POLICY_H_
+#define NEBULA_NET_RPC_ZRPC_CLIENT_POLICY_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// 客户端方法选项
+struct ZRpcClientMethodOption {
+  // 幂等方法允许重发: 连接断开等失败时换一个连接重试
+  bool idempotent {false};
+  // 幂等方法才允许对冲: 超过p95还未应答则再发给另一个后端, 取先到的应答
+  bool hedge {false};
+  // 对冲延时(毫秒)的上下限, 没有统计数据时使用上限
+  uint32_t hedge_min_delay_ms {5};
+  uint32_t hedge_max_delay_ms {1000};
+  // 应答缓存时间(毫秒), 0为不缓存, 相同payload的请求在有效期内直接返回缓存的RpcOk
+  uint32_t cache_ttl_ms {0};
+  // 缓存和合并默认按auth_id区分, 应答和调用者无关(比如公共配置)时设为true, 所有用户共享
+  bool cache_shared {false};
+  // 相同payload的并发请求只发一个, 所有调用共享同一个应答
+  bool single_flight {false};
+};
+
+struct ZRpcClientMethodEntry {
+  // 对冲延时(微秒), 定期按客户端p95刷新
+  uint64_t GetHedgeDelay() const;
+  
+  int method_id {0};
+  ZRpcClientMethodOption option;
+  
+  mutable std::atomic<uint64_t> hedge_delay_us {0};
+  mutable std::atomic<uint64_t> hedge_delay_update_us {0};
+};
+
+// 客户端方法表
+// 启动时注册，第一次查找时冻结，之后只读，查找不加锁
+class ZRpcClientMethodTable {
+public:
+  static ZRpcClientMethodTable& GetInstance();
+  
+  bool Register(int method_id, const ZRpcClientMethodOption& option);
+  
+  // 未注册返回nullptr
+  const ZRpcClientMethodEntry* Find(int method_id) {
+    if (!frozen_.load(std::memory_order_acquire)) {
+      Freeze();
+    }
+    
+    auto it = entries_.find(method_id);
+    return it == entries_.end() ? nullptr : it->second.get();
+  }
+  
+private:
+  ZRpcClientMethodTable() = default;
+  
+  void Freeze() {
+    std::lock_guard<std::mutex> g(mutex_);
+    frozen_.store(true, std::memory_order_release);
+  }
+  
+  std::mutex mutex_;
+  std::atomic<bool> frozen_ {false};
+  std::unordered_map<int, std::unique_ptr<ZRpcClientMethodEntry>> entries_;
+};
+
+// 全局重试预算
+// 每个请求存入ratio个令牌, 每次重试或对冲取出一个, 令牌不足则放弃重试
+// 这样重试量最多为正常请求量的ratio倍, 后端整体故障时不会引发重试风暴
+class ZRpcRetryBudget {
+public:
+  static ZRpcRetryBudget& GetInstance();
+  
+  void OnRequest();
+  bool TryRetry();
+  
+  // 预算调整, 启动时设置
+  void SetConf(double ratio, uint32_t max_tokens);
+
+private:
+  ZRpcRetryBudget() = default;
+  
+  enum {
+    kTokenScale = 1000,
+  };
+  
+  // 以1/kTokenScale个令牌为单位
+  std::atomic<int64_t> tokens_ {0};
+  int64_t deposit_ {kTokenScale / 10};
+  int64_t max_tokens_ {100 * kTokenScale};
+};
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/rpc/zrpc_latency_stats.h"
+
+#include <folly/Format.h>
+#include <folly/Hash.h>
+#include <folly/ThreadId.h>
+#include <folly/SingletonThreadLocal.h>
+
+namespace {
+
+inline size_t GetShardIndex() {
+  return static_cast<size_t>(folly::hash::twang_mix64(folly::getCurrentThreadID())) %
+      ZRpcLatencyHistogram::kShards;
+}
+
+struct LatencyStatsCache {
+  std::unordered_map<uint64_t, ZRpcLatencyHistogram*> histograms;
+};
+
+}
+
+size_t ZRpcLatencyHistogram::GetBucketIndex(uint64_t usec) {
+  if (usec < kLinearBuckets) {
+    return static_cast<size_t>(usec);
+  }
+  
+  // usec >= 8, 最高位p >= 3
+  size_t p = 63 - __builtin_clzll(usec);
+  if (p >= kMaxPower) {
+    return kBuckets - 1;
+  }
+  size_t sub = (usec >> (p - 2)) & (kSubBuckets - 1);
+  return kLinearBuckets + (p - 3) * kSubBuckets + sub;
+}
+
+uint64_t ZRpcLatencyHistogram::GetBucketLowerBound(size_t idx) {
+  if (idx < kLinearBuckets) {
+    return idx;
+  }
+  size_t p = (idx - kLinearBuckets) / kSubBuckets + 3;
+  size_t sub = (idx - kLinearBuckets) % kSubBuckets;
+  return static_cast<uint64_t>(kSubBuckets + sub) << (p - 2);
+}
+
+uint64_t ZRpcLatencyHistogram::GetBucketUpperBound(size_t idx) {
+  if (idx + 1 >= kBuckets) {
+    return UINT64_MAX;
+  }
+  return GetBucketLowerBound(idx + 1) - 1;
+}
+
+void ZRpcLatencyHistogram::Add(uint64_t usec) {
+  auto& shard = shards_[GetShardIndex()];
+  shard.buckets[GetBucketIndex(usec)].fetch_add(1, std::memory_order_relaxed);
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(usec, std::memory_order_relaxed);
+  
+  auto max = shard.max.load(std::memory_order_relaxed);
+  while (usec > max &&
+         !shard.max.compare_exchange_weak(max, usec, std::memory_order_relaxed)) {
+  }
+}
+
+void ZRpcLatencyHistogram::GetSnapshot(Snapshot* snapshot) const {
+  snapshot->buckets.assign(kBuckets, 0);
+  for (auto& shard : shards_) {
+    snapshot->count += shard.count.load(std::memory_order_relaxed);
+    snapshot->sum += shard.sum.load(std::memory_order_relaxed);
+    snapshot->max = std::max(snapshot->max, shard.max.load(std::memory_order_relaxed));
+    for (size_t i = 0; i < kBuckets; ++i) {
+      snapshot->buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+}
+
+uint64_t ZRpcLatencyHistogram::Snapshot::GetPercentile(double pct) const {
+  if (count == 0 || buckets.empty()) {
+    return 0;
+  }
+  
+  uint64_t target = static_cast<uint64_t>(count * pct / 100.0);
+  if (target >= count) {
+    target = count - 1;
+  }
+  
+  uint64_t n = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    n += buckets[i];
+    if (n > target) {
+      // 取桶的上限, 不超过最大值
+      return std::min(GetBucketUpperBound(i), max);
+    }
+  }
+  return max;
+}
+
+std::string ZRpcLatencyReport::ToString() const {
+  return folly::sformat("{{side: {}, method_id: {}, backend: {}, response_type: {}, count: {}, "
+                        "avg: {}us, p50: {}us, p90: {}us, p99: {}us, p999: {}us, max: {}us}}",
+                        ::ToString(side),
+                        method_id,
+                        backend,
+                        response_type,
+                        count,
+                        avg,
+                        p50,
+                        p90,
+                        p99,
+                        p999,
+                        max);
+}
+
+ZRpcLatencyStats& ZRpcLatencyStats::GetInstance() {
+  static ZRpcLatencyStats g_latency_stats;
+  return g_latency_stats;
+}
+
+uint32_t ZRpcLatencyStats::GetBackendID(const std::string& backend) {
+  std::lock_guard<std::mutex> g(mutex_);
+  for (size_t i = 0; i < backends_.size(); ++i) {
+    if (backends_[i] == backend) {
+      return static_cast<uint32_t>(i);
+    }
+  }
+  backends_.push_back(backend);
+  return static_cast<uint32_t>(backends_.size() - 1);
+}
+
+ZRpcLatencyHistogram* ZRpcLatencyStats::GetOrCreateHistogram(uint64_t key) {
+  auto& cache = folly::SingletonThreadLocal<LatencyStatsCache>::get().histograms;
+  auto it = cache.find(key);
+  if (it != cache.end()) {
+    return it->second;
+  }
+  
+  ZRpcLatencyHistogram* histogram = nullptr;
+  {
+    std::lock_guard<std::mutex> g(mutex_);
+    auto& v = histograms_[key];
+    if (!v) {
+      v.reset(new ZRpcLatencyHistogram());
+    }
+    histogram = v.get();
+  }
+  cache.emplace(key, histogram);
+  return histogram;
+}
+
+void ZRpcLatencyStats::Record(ZRpcSide side, int method_id, uint32_t backend_id, uint8_t response_type, uint64_t usec) {
+  GetOrCreateHistogram(MakeKey(side, method_id, backend_id, response_type))->Add(usec);
+}
+
+void ZRpcLatencyStats::GetReports(std::vector<ZRpcLatencyReport>* reports) {
+  reports->clear();
+  
+  std::lock_guard<std::mutex> g(mutex_);
+  for (auto& v : histograms_) {
+    ZRpcLatencyHistogram::Snapshot snapshot;
+    v.second->GetSnapshot(&snapshot);
+    
+    ZRpcLatencyReport report;
+    report.side = static_cast<ZRpcSide>(v.first & 0x1);
+    report.response_type = static_cast<uint8_t>((v.first >> 1) & 0xFF);
+    auto backend_id = static_cast<size_t>((v.first >> 9) & 0x7FFFFF);
+    if (backend_id < backends_.size()) {
+      report.backend = backends_[backend_id];
+    }
+    report.method_id = static_cast<int>(static_cast<uint32_t>(v.first >> 32));
+    report.count = snapshot.count;
+    report.avg = snapshot.count > 0 ? snapshot.sum / snapshot.count : 0;
+    report.p50 = snapshot.GetPercentile(50);
+    report.p90 = snapshot.GetPercentile(90);
+    report.p99 = snapshot.GetPercentile(99);
+    report.p999 = snapshot.GetPercentile(99.9);
+    report.max = snapshot.max;
+    reports->push_back(std::move(report));
+  }
+}
+
+uint64_t ZRpcLatencyStats::GetMethodPercentile(ZRpcSide side, int method_id, double pct) {
+  ZRpcLatencyHistogram::Snapshot merged;
+  merged.buckets.assign(ZRpcLatencyHistogram::kBuckets, 0);
+  
+  std::lock_guard<std::mutex> g(mutex_);
+  for (auto& v : histograms_) {
+    if (static_cast<ZRpcSide>(v.first & 0x1) != side ||
+        static_cast<int>(static_cast<uint32_t>(v.first >> 32)) != method_id) {
+      continue;
+    }
+    
+    ZRpcLatencyHistogram::Snapshot snapshot;
+    v.second->GetSnapshot(&snapshot);
+    merged.count += snapshot.count;
+    merged.sum += snapshot.sum;
+    merged.max = std::max(merged.max, snapshot.max);
+    for (size_t i = 0; i < merged.buckets.size(); ++i) {
+      merged.buckets[i] += snapshot.buckets[i];
+    }
+  }
+  
+  return merged.GetPercentile(pct);
+}
@@ -0,0 +1,148 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_RPC_ZRPC_LATENCY_STATS_H_
+#define NEBULA_NET_RPC_ZRPC_LATENCY_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 延时直方图(微秒)
+// 对数分桶: 小于8us每us一个桶, 之后每个2的幂区间分成4个子桶, 相对误差不超过25%
+// 按线程分片, 写入只做relaxed原子加, 读时合并所有分片
+class ZRpcLatencyHistogram {
+public:
+  enum {
+    kLinearBuckets = 8,
+    kSubBuckets = 4,
+    kMaxPower = 40,     // 2^40us, 约12天
+    kBuckets = kLinearBuckets + (kMaxPower - 3) * kSubBuckets + 1,
+    kShards = 8,
+  };
+  
+  void Add(uint64_t usec);
+  
+  // 合并后的快照
+  struct Snapshot {
+    // pct: 0~100
+    uint64_t GetPercentile(double pct) const;
+    
+    uint64_t count {0};
+    uint64_t sum {0};
+    uint64_t max {0};
+    std::vector<uint64_t> buckets;
+  };
+  
+  void GetSnapshot(Snapshot* snapshot) const;
+  
+  static size_t GetBucketIndex(uint64_t usec);
+  // 桶的下限和上限
+  static uint64_t GetBucketLowerBound(size_t idx);
+  static uint64_t GetBucketUpperBound(size_t idx);
+  
+private:
+  struct alignas(64) Shard {
+    Shard() {
+      for (auto& v : buckets) {
+        v.store(0, std::memory_order_relaxed);
+      }
+    }
+    
+    std::atomic<uint64_t> count {0};
+    std::atomic<uint64_t> sum {0};
+    std::atomic<uint64_t> max {0};
+    std::atomic<uint64_t> buckets[kBuckets];
+  };
+  
+  Shard shards_[kShards];
+};
+
+enum class ZRpcSide : int {
+  CLIENT = 0,
+  SERVER = 1,
+};
+
+inline const char* ToString(ZRpcSide side) {
+  return side == ZRpcSide::CLIENT ? "CLIENT" : "SERVER";
+}
+
+// 按 方法 x 后端地址 x 应答类型 统计
+struct ZRpcLatencyReport {
+  std::string ToString() const;
+  
+  ZRpcSide side {ZRpcSide::CLIENT};
+  int method_id {0};
+  std::string backend;
+  uint8_t response_type {0};
+  
+  uint64_t count {0};
+  uint64_t avg {0};
+  uint64_t p50 {0};
+  uint64_t p90 {0};
+  uint64_t p99 {0};
+  uint64_t p999 {0};
+  uint64_t max {0};
+};
+
+// zrpc延时统计
+//  客户端: ZRpcMultiplexClientDispatcher::operator() -> read
+//  服务端: ZRpcService::operator() -> 应答完成, backend为本服务的监听地址
+class ZRpcLatencyStats {
+public:
+  static ZRpcLatencyStats& GetInstance();
+  
+  // 单调时间(微秒), 计算延时用
+  static uint64_t NowInUsec() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // 后端地址转成id, 每个连接只需要转一次
+  uint32_t GetBackendID(const std::string& backend);
+  
+  void Record(ZRpcSide side, int method_id, uint32_t backend_id, uint8_t response_type, uint64_t usec);
+  
+  // 所有直方图的百分位
+  void GetReports(std::vector<ZRpcLatencyReport>* reports);
+  
+  // 指定方法(合并所有后端和应答类型)的百分位, 未统计到返回0
+  uint64_t GetMethodPercentile(ZRpcSide side, int method_id, double pct);
+  
+private:
+  ZRpcLatencyStats() = default;
+  
+  static uint64_t MakeKey(ZRpcSide side, int method_id, uint32_t backend_id, uint8_t response_type) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(method_id)) << 32) |
+            (static_cast<uint64_t>(backend_id & 0x7FFFFF) << 9) |
+            (static_cast<uint64_t>(response_type) << 1) |
+            static_cast<uint64_t>(side);
+  }
+  
+  ZRpcLatencyHistogram* GetOrCreateHistogram(uint64_t key);
+  
+  // 只有第一次使用某个key时才加锁, 之后走线程本地缓存
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, std::unique_ptr<ZRpcLatencyHistogram>> histograms_;
+  std::vector<std::string> backends_;
+};
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/rpc/zrpc_method_table.h"
+
+#include <algorithm>
+#include <map>
+
+#include <folly/Format.h>
+#include <wangle/concurrent/CPUThreadPoolExecutor.h>
+
+#include "nebula/net/net_engine_manager.h"
+
+// 下标表最多允许的空洞倍数, 超过则使用二分查找
+const size_t kMaxIndexSparseFactor = 4;
+const size_t kMaxIndexSize = 65536;
+
+// 未配置cpu/fiber线程组时使用的默认线程池的线程数
+const size_t kDefaultCPUThreads = 10;
+
+namespace {
+
+folly::Executor* GetDefaultCPUExecutor() {
+  static auto g_executor = std::make_shared<wangle::CPUThreadPoolExecutor>(kDefaultCPUThreads);
+  return g_executor.get();
+}
+
+// 通过ZRpcExecType找线程组, INLINE返回nullptr
+// 线程组未配置时用默认线程池, 不退回到IO线程里执行
+folly::Executor* ResolveMethodExecutor(ZRpcExecType exec_type) {
+  nebula::ThreadGroupPtr group;
+  switch (exec_type) {
+    case ZRpcExecType::CPU:
+      group = nebula::NetEngineManager::GetInstance()->GetThreadGroupByThreadType(nebula::ThreadType::CPU);
+      break;
+    case ZRpcExecType::FIBER:
+      group = nebula::NetEngineManager::GetInstance()->GetThreadGroupByThreadType(nebula::ThreadType::FIBER);
+      break;
+    default:
+      return nullptr;
+  }
+  
+  if (!group) {
+    LOG(WARNING) << "ResolveMethodExecutor - thread_group not config: " << ToString(exec_type)
+                 << ", use default cpu executor, threads: " << kDefaultCPUThreads;
+    return GetDefaultCPUExecutor();
+  }
+  return group->GetThreadPool().get();
+}
+
+}
+
+std::string ZRpcMethodStats::ToString() const {
+  return folly::sformat("{{method_id: {}, calls: {}, errors: {}, in_flight: {}, bytes_in: {}, bytes_out: {}}}",
+                        method_id,
+                        calls,
+                        errors,
+                        in_flight,
+                        bytes_in,
+                        bytes_out);
+}
+
+void ZRpcMethodEntry::OnCallStart(uint32_t bytes_in) const {
+  auto& c = **counters;
+  c.calls.fetch_add(1, std::memory_order_relaxed);
+  c.in_flight.fetch_add(1, std::memory_order_relaxed);
+  c.bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+}
+
+void ZRpcMethodEntry::OnCallEnd(const ProtoRpcResponsePtr& response) const {
+  auto& c = **counters;
+  c.in_flight.fetch_sub(1, std::memory_order_relaxed);
+  if (!response || response->GetPackageType() != Package::RPC_OK) {
+    c.errors.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (response) {
+    c.bytes_out.fetch_add(response->CalcPackageSize(), std::memory_order_relaxed);
+  }
+}
+
+ZRpcMethodStats ZRpcMethodEntry::GetStats() const {
+  ZRpcMethodStats stats;
+  stats.method_id = method_id;
+  for (const auto& c : counters->accessAllThreads()) {
+    stats.calls += c.calls.load(std::memory_order_relaxed);
+    stats.errors += c.errors.load(std::memory_order_relaxed);
+    stats.in_flight += c.in_flight.load(std::memory_order_relaxed);
+    stats.bytes_in += c.bytes_in.load(std::memory_order_relaxed);
+    stats.bytes_out += c.bytes_out.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+ZRpcMethodTable& ZRpcMethodTable::GetInstance() {
+  static ZRpcMethodTable g_method_table;
+  return g_method_table;
+}
+
+bool ZRpcMethodTable::Register(ZRpcMethodEntry&& entry) {
+  std::lock_guard<std::mutex> g(mutex_);
+  
+  if (frozen_.load(std::memory_order_relaxed)) {
+    LOG(ERROR) << "Register - method table frozen, method_id: " << entry.method_id;
+    return false;
+  }
+  
+  for (auto& v : entries_) {
+    if (v.method_id == entry.method_id) {
+      LOG(ERROR) << "Register - duplicate entry for method_id: " << entry.method_id;
+      return false;
+    }
+  }
+  
+  entries_.push_back(std::move(entry));
+  return true;
+}
+
+void ZRpcMethodTable::Freeze() {
+  std::lock_guard<std::mutex> g(mutex_);
+  if (frozen_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  
+  std::sort(entries_.begin(), entries_.end(),
+            [](const ZRpcMethodEntry& a, const ZRpcMethodEntry& b) {
+              return a.method_id < b.method_id;
+            });
+
+  // 每种exec_type只解析一次, 线程组缺失的警告只打一次
+  std::map<ZRpcExecType, folly::Executor*> executors;
+  for (auto& v : entries_) {
+    v.admission.reset(new ZRpcAdmission(v.option));
+    
+    auto it = executors.find(v.option.exec_type);
+    if (it == executors.end()) {
+      it = executors.emplace(v.option.exec_type, ResolveMethodExecutor(v.option.exec_type)).first;
+    }
+    v.executor = it->second;
+  }
+  
+  if (!entries_.empty()) {
+    int64_t range = static_cast<int64_t>(entries_.back().method_id) - entries_.front().method_id + 1;
+    if (range <= static_cast<int64_t>(kMaxIndexSize) &&
+        range <= static_cast<int64_t>(entries_.size() * kMaxIndexSparseFactor)) {
+      min_method_id_ = entries_.front().method_id;
+      index_.assign(static_cast<size_t>(range), -1);
+      for (size_t i = 0; i < entries_.size(); ++i) {
+        index_[entries_[i].method_id - min_method_id_] = static_cast<int32_t>(i);
+      }
+    }
+  }
+  
+  LOG(INFO) << "Freeze - method table: " << entries_.size() << " methods, "
+            << (index_.empty() ? "binary search" : "direct index");
+  frozen_.store(true, std::memory_order_release);
+}
+
+const ZRpcMethodEntry* ZRpcMethodTable::BinarySearch(int method_id) const {
+  auto it = std::lower_bound(entries_.begin(), entries_.end(), method_id,
+                             [](const ZRpcMethodEntry& a, int id) {
+                               return a.method_id < id;
+                             });
+  if (it == entries_.end() || it->method_id != method_id) {
+    return nullptr;
+  }
+  return &(*it);
+}
+
+bool ZRpcMethodTable::HasUnaryMethod(int method_id) {
+  auto is_unary = [](const ZRpcMethodEntry* entry) {
+    return entry && (entry->func || entry->async_func);
+  };
+  
+  if (frozen_.load(std::memory_order_acquire)) {
+    return is_unary(Find(method_id));
+  }
+  
+  std::lock_guard<std::mutex> g(mutex_);
+  // 加锁期间可能已被冻结, 冻结后entries_不再变化, 顺序查找仍然正确
+  for (auto& v : entries_) {
+    if (v.method_id == method_id) {
+      return is_unary(&v);
+    }
+  }
+  return false;
+}
+
+void ZRpcMethodTable::GetStats(std::vector<ZRpcMethodStats>* stats) {
+  if (!frozen_.load(std::memory_order_acquire)) {
+    Freeze();
+  }
+  
+  stats->clear();
+  stats->reserve(entries_.size());
+  for (auto& v : entries_) {
+    stats->push_back(v.GetStats());
+  }
+}
@@ -0,0 +1,181 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_RPC_ZRPC_METHOD_TABLE_H_
+#define NEBULA_NET_RPC_ZRPC_METHOD_TABLE_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <folly/ThreadLocal.h>
+#include <folly/futures/Future.h>
+
+#include "nebula/net/zproto/zproto_package_data.h"
+#include "nebula/net/rpc/zrpc_admission.h"
+#include "nebula/net/rpc/zrpc_stream.h"
+
+// 服务端方法的执行方式
+enum class ZRpcExecType : int {
+  INLINE = 0,     // 在IO线程里直接执行，只适合不阻塞的方法
+  CPU = 1,        // 投递到CPU线程组执行
+  FIBER = 2,      // 投递到FIBER线程组执行
+};
+
+inline const char* ToString(ZRpcExecType exec_type) {
+  const char* s = "UNKNOWN";
+  
+  switch(exec_type) {
+    case ZRpcExecType::INLINE:
+      s = "INLINE";
+      break;
+    case ZRpcExecType::CPU:
+      s = "CPU";
+      break;
+    case ZRpcExecType::FIBER:
+      s = "FIBER";
+      break;
+    default:
+      break;
+  }
+  
+  return s;
+}
+
+// 服务端方法选项
+struct ZRpcMethodOption {
+  ZRpcMethodOption() = default;
+  explicit ZRpcMethodOption(ZRpcExecType type)
+    : exec_type(type) {}
+  
+  ZRpcExecType exec_type {ZRpcExecType::INLINE};
+  // 投递到线程组后允许排队的最大请求数, 0为不限制
+  uint32_t max_queue_size {0};
+  // 最大并发(已接收还未应答), 0为不限制
+  uint32_t max_in_flight {0};
+  // CoDel排队延时目标和观察窗口(毫秒), target为0不启用, 只对投递到线程组的方法有效
+  uint32_t codel_target_ms {0};
+  uint32_t codel_interval_ms {100};
+  // 过载拒绝时RpcFloodWait建议客户端的重试延时(秒)
+  int32_t flood_wait_delay {1};
+};
+
+// 方法统计，所有线程合并后的结果
+struct ZRpcMethodStats {
+  std::string ToString() const;
+  
+  int method_id {0};
+  uint64_t calls {0};
+  uint64_t errors {0};
+  int64_t in_flight {0};
+  uint64_t bytes_in {0};
+  uint64_t bytes_out {0};
+};
+
+// 每个线程一份计数
+// 开始和结束可能不在同一个线程(方法被投递到其它线程组)，
+// 所以in_flight只有合并后才有意义
+struct ZRpcMethodCounters {
+  std::atomic<uint64_t> calls {0};
+  std::atomic<uint64_t> errors {0};
+  std::atomic<int64_t> in_flight {0};
+  std::atomic<uint64_t> bytes_in {0};
+  std::atomic<uint64_t> bytes_out {0};
+};
+
+struct ZRpcMethodCountersTag {};
+
+struct ZRpcMethodEntry {
+  using ServiceFunc = std::function<ProtoRpcResponsePtr(RpcRequestPtr)>;
+  using AsyncServiceFunc = std::function<folly::Future<ProtoRpcResponsePtr>(RpcRequestPtr)>;
+  // 流式方法: 通过writer返回数据, 返回的Future为结束包
+  using StreamServiceFunc = std::function<folly::Future<ProtoRpcResponsePtr>(RpcRequestPtr, ZRpcStreamWriterPtr)>;
+  using ThreadLocalCounters = folly::ThreadLocal<ZRpcMethodCounters, ZRpcMethodCountersTag>;
+  
+  ZRpcMethodEntry()
+    : counters(new ThreadLocalCounters()) {}
+  
+  void OnCallStart(uint32_t bytes_in) const;
+  void OnCallEnd(const ProtoRpcResponsePtr& response) const;
+  
+  ZRpcMethodStats GetStats() const;
+
+  int method_id {0};
+  // func/async_func/stream_func只设置一个
+  ServiceFunc func;
+  AsyncServiceFunc async_func;
+  StreamServiceFunc stream_func;
+  ZRpcMethodOption option;
+  
+  // 冻结时按option创建
+  std::unique_ptr<ZRpcAdmission> admission;
+  // 冻结时按exec_type解析, INLINE为nullptr
+  folly::Executor* executor {nullptr};
+  std::unique_ptr<ThreadLocalCounters> counters;
+};
+
+// 方法表
+// 启动时注册，第一次查找时冻结成按method_id排序的数组，之后只读，查找不加锁
+// method_id比较连续时直接按下标查找，否则二分查找
+// 冻结时解析各方法的执行线程池, 所以必须在线程组创建之后(服务启动后)才查找
+class ZRpcMethodTable {
+public:
+  static ZRpcMethodTable& GetInstance();
+  
+  bool Register(ZRpcMethodEntry&& entry);
+  
+  // 未找到返回nullptr
+  const ZRpcMethodEntry* Find(int method_id) {
+    if (!frozen_.load(std::memory_order_acquire)) {
+      Freeze();
+    }
+    
+    if (!index_.empty()) {
+      int64_t i = static_cast<int64_t>(method_id) - min_method_id_;
+      if (i < 0 || i >= static_cast<int64_t>(index_.size()) || index_[i] < 0) {
+        return nullptr;
+      }
+      return &entries_[index_[i]];
+    }
+    
+    return BinarySearch(method_id);
+  }
+  
+  void GetStats(std::vector<ZRpcMethodStats>* stats);
+  
+  // 是否注册了method_id的非流式方法
+  // 客户端用, 不冻结方法表(服务端可能还没注册完)
+  bool HasUnaryMethod(int method_id);
+  
+private:
+  ZRpcMethodTable() = default;
+  
+  void Freeze();
+  const ZRpcMethodEntry* BinarySearch(int method_id) const;
+  
+  // 只保护注册和冻结
+  std::mutex mutex_;
+  std::atomic<bool> frozen_ {false};
+  
+  std::vector<ZRpcMethodEntry> entries_;
+  int min_method_id_ {0};
+  // method_id-min_method_id_ -> entries_下标, -1为未注册
+  std::vector<int32_t> index_;
+};
+
+#endif
@@ -20,7 +20,6 @@
 
 #include <wangle/service/Service.h>
 #include <wangle/service/ExpiringFilter.h>
-#include <wangle/service/ExecutorFilter.h>
 #include <wangle/service/ServerDispatcher.h>
 
 #include <wangle/channel/AsyncSocketHandler.h>
@@ -28,6 +27,7 @@
 //#include <wangle/codec/LengthFieldPrepender.h>
 #include <wangle/channel/EventBaseHandler.h>
 
+#include "nebula/net/handler/conn_flow_control_handler.h"
 #include "nebula/net/handler/zproto/zproto_frame_handler.h"
 #include "nebula/net/handler/zproto/zproto_package_handler.h"
 
@@ -50,6 +50,9 @@ ZRpcClientPipeline::Ptr ZRpcClientPipelineFactory::newPipeline(std::shared_ptr<f
   pipeline->setTransportInfo(transportInfo);
 
   pipeline->addBack(wangle::AsyncSocketHandler(sock));
+  if (nebula::ConnFlowControlHandler::IsEnabled(service_->GetServiceConfig())) {
+    pipeline->addBack(nebula::ConnFlowControlHandler(service_->GetServiceConfig()));
+  }
   // ensure we can write from any thread
   pipeline->addBack(wangle::EventBaseHandler());
   pipeline->addBack(ZProtoFrameDecoder());
@@ -64,6 +67,9 @@ ZRpcClientPipeline::Ptr ZRpcClientPipelineFactory::newPipeline(std::shared_ptr<f
 ZRpcServerPipeline::Ptr ZRpcServerPipelineFactory::newPipeline(std::shared_ptr<folly::AsyncTransportWrapper> sock) {
   auto pipeline = ZRpcServerPipeline::create();
   pipeline->addBack(wangle::AsyncSocketHandler(sock));
+  if (nebula::ConnFlowControlHandler::IsEnabled(service_->GetServiceConfig())) {
+    pipeline->addBack(nebula::ConnFlowControlHandler(service_->GetServiceConfig()));
+  }
   // ensure we can write from any thread
   pipeline->addBack(wangle::EventBaseHandler());
   
@@ -78,7 +84,7 @@ ZRpcServerPipeline::Ptr ZRpcServerPipelineFactory::newPipeline(std::shared_ptr<f
   // pipeline->addBack(SerialServerDispatcher<Bonk>(&service_));
   // Or a Pipelined Dispatcher
   // pipeline->addBack(PipelinedServerDispatcher<Bonk>(&service_));
-  pipeline->addBack(wangle::MultiplexServerDispatcher<RpcRequestPtr, ProtoRpcResponsePtr>(&rpc_service_));
+  pipeline->addBack(wangle::MultiplexServerDispatcher<RpcRequestPtr, ProtoRpcResponsePtr>(rpc_service_.get()));
   pipeline->finalize();
   
   return pipeline;
@@ -18,10 +18,9 @@
 #ifndef NEBULA_NET_RPC_ZRPC_PIPELINE_FACTORY_H_
 #define NEBULA_NET_RPC_ZRPC_PIPELINE_FACTORY_H_
 
+#include <folly/Format.h>
 #include <wangle/service/Service.h>
-#include <wangle/service/ExecutorFilter.h>
 #include <wangle/channel/AsyncSocketHandler.h>
-#include <wangle/concurrent/CPUThreadPoolExecutor.h>
 
 #include "nebula/net/rpc/zrpc_client_handler.h"
 #include "nebula/net/rpc/zrpc_server_handler.h"
@@ -43,14 +42,15 @@ private:
 class ZRpcServerPipelineFactory : public wangle::PipelineFactory<ZRpcServerPipeline> {
 public:
   ZRpcServerPipelineFactory(nebula::ServiceBase* service)
-    : service_(service) {}
+    : rpc_service_(std::make_shared<ZRpcService>(
+          folly::sformat("{}:{}", service->GetServiceConfig().hosts, service->GetServiceConfig().port))),
+      service_(service) {}
 
   ZRpcServerPipeline::Ptr newPipeline(std::shared_ptr<folly::AsyncTransportWrapper> sock) override;
   
 private:
-  wangle::ExecutorFilter<RpcRequestPtr, ProtoRpcResponsePtr> rpc_service_{
-    std::make_shared<wangle::CPUThreadPoolExecutor>(10),
-    std::make_shared<ZRpcService>()};
+  // 执行线程由每个方法的ZRpcMethodOption决定
+  std::shared_ptr<ZRpcService> rpc_service_;
   
   nebula::ServiceBase* service_{nullptr};
 };
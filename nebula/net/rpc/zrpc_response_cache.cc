@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/rpc/zrpc_response_cache.h"
+
+#include <algorithm>
+
+#include <folly/Hash.h>
+#include <folly/SpookyHashV2.h>
+
+#include "nebula/net/rpc/zrpc_latency_stats.h"
+
+ZRpcRequestKey ZRpcRequestKey::Make(const std::string& service_name, const RpcRequestPtr& request, bool shared) {
+  ZRpcRequestKey key;
+  auto encoded = std::dynamic_pointer_cast<EncodedRpcRequest>(request);
+  if (!encoded || !encoded->message.payload) {
+    return key;
+  }
+  
+  folly::hash::SpookyHashV2 spooky;
+  spooky.Init(0, 0);
+  for (auto& range : *encoded->message.payload) {
+    spooky.Update(range.data(), range.size());
+  }
+  uint64_t h1 = 0, h2 = 0;
+  spooky.Final(&h1, &h2);
+  
+  key.valid = true;
+  key.method_id = encoded->method_id;
+  key.auth_id = shared ? 0 : encoded->auth_id();
+  key.service_name = service_name;
+  key.hash = folly::hash::hash_128_to_64(h1, static_cast<uint64_t>(key.method_id));
+  key.hash = folly::hash::hash_128_to_64(key.hash,
+      folly::hash::hash_128_to_64(folly::hash::fnv64(service_name), static_cast<uint64_t>(key.auth_id)));
+  // payload的生命期跟随请求
+  key.payload = std::shared_ptr<folly::IOBuf>(encoded, encoded->message.payload.get());
+  return key;
+}
+
+bool ZRpcRequestKey::IsSameRequest(const ZRpcRequestKey& other) const {
+  return valid &&
+          other.valid &&
+          method_id == other.method_id &&
+          hash == other.hash &&
+          auth_id == other.auth_id &&
+          service_name == other.service_name &&
+          folly::IOBufEqual()(*payload, *other.payload);
+}
+
+ZRpcResponseCache& ZRpcResponseCache::GetInstance() {
+  static ZRpcResponseCache g_response_cache;
+  return g_response_cache;
+}
+
+ZRpcResponseCache::ZRpcResponseCache() {
+  for (auto& v : shards_) {
+    v.reset(new Shard(kDefaultCapacity / kShardCount));
+  }
+}
+
+void ZRpcResponseCache::SetCapacity(size_t capacity) {
+  for (auto& v : shards_) {
+    std::lock_guard<std::mutex> g(v->mutex);
+    v->lru.setMaxSize(std::max<size_t>(capacity / kShardCount, 1));
+  }
+}
+
+ProtoRpcResponsePtr ZRpcResponseCache::Get(const ZRpcRequestKey& key, int64_t req_message_id) {
+  if (!key.valid) {
+    return nullptr;
+  }
+  
+  std::shared_ptr<EncodedRpcOk> cached;
+  auto& shard = GetShard(key);
+  {
+    std::lock_guard<std::mutex> g(shard.mutex);
+    auto it = shard.lru.find(key.hash);
+    if (it == shard.lru.end()) {
+      return nullptr;
+    }
+    if (it->second.expire_time <= ZRpcLatencyStats::NowInUsec()) {
+      shard.lru.erase(key.hash);
+      return nullptr;
+    }
+    if (!key.IsSameRequest(it->second.key)) {
+      return nullptr;
+    }
+    cached = it->second.rsp;
+  }
+  
+  // 缓存的应答只读, 每次命中返回一个共享payload的副本
+  auto rsp = cached->Clone();
+  rsp->set_req_message_id(req_message_id);
+  return rsp;
+}
+
+void ZRpcResponseCache::Put(const ZRpcRequestKey& key, const ProtoRpcResponsePtr& rsp, uint32_t ttl_ms) {
+  if (!key.valid || ttl_ms == 0 || rsp->GetPackageType() != Package::RPC_OK) {
+    return;
+  }
+  auto ok = std::dynamic_pointer_cast<EncodedRpcOk>(rsp);
+  if (!ok || !ok->message.payload) {
+    return;
+  }
+  
+  // 调用方可能还在使用rsp, 缓存一份共享payload的副本
+  auto cached = std::make_shared<EncodedRpcOk>();
+  cached->package_header = ok->package_header;
+  cached->method_response_id = ok->method_response_id;
+  auto payload = ok->message.payload->clone();
+  cached->message.SwapPayload(payload);
+  
+  Entry entry;
+  entry.key = key;
+  // 不持有请求本身
+  entry.key.payload = std::shared_ptr<folly::IOBuf>(key.payload->clone());
+  entry.rsp = cached;
+  entry.expire_time = ZRpcLatencyStats::NowInUsec() + ttl_ms * 1000ULL;
+  
+  auto& shard = GetShard(key);
+  std::lock_guard<std::mutex> g(shard.mutex);
+  shard.lru.set(key.hash, std::move(entry));
+}
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_RPC_ZRPC_RESPONSE_CACHE_H_
+#define NEBULA_NET_RPC_ZRPC_RESPONSE_CACHE_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <folly/EvictingCacheMap.h>
+
+#include "nebula/net/zproto/zproto_package_data.h"
+
+// 请求的内容标识: service_name + auth_id + method_id + payload哈希
+// shared为true时不区分auth_id(应答和调用者无关), 不同用户共享缓存
+// 只有EncodedRpcRequest有payload, 其它请求valid为false
+struct ZRpcRequestKey {
+  static ZRpcRequestKey Make(const std::string& service_name, const RpcRequestPtr& request, bool shared);
+  
+  // 哈希相同时再比较payload内容
+  bool IsSameRequest(const ZRpcRequestKey& other) const;
+  
+  bool valid {false};
+  int method_id {0};
+  int64_t auth_id {0};
+  std::string service_name;
+  uint64_t hash {0};
+  // 共享请求的payload, 不拷贝
+  std::shared_ptr<folly::IOBuf> payload;
+};
+
+// 客户端应答缓存
+// 按ZRpcRequestKey分片, 每个分片是一个加锁的LRU
+// 只缓存EncodedRpcOk, 命中时返回共享payload的副本
+class ZRpcResponseCache {
+public:
+  static ZRpcResponseCache& GetInstance();
+  
+  // 总容量(条), 启动时设置
+  void SetCapacity(size_t capacity);
+  
+  // 未命中或已过期返回nullptr
+  ProtoRpcResponsePtr Get(const ZRpcRequestKey& key, int64_t req_message_id);
+  void Put(const ZRpcRequestKey& key, const ProtoRpcResponsePtr& rsp, uint32_t ttl_ms);
+  
+private:
+  ZRpcResponseCache();
+  
+  enum {
+    kShardCount = 16,
+    kDefaultCapacity = 65536,
+  };
+  
+  struct Entry {
+    ZRpcRequestKey key;
+    std::shared_ptr<EncodedRpcOk> rsp;
+    uint64_t expire_time {0};
+  };
+  
+  struct Shard {
+    explicit Shard(size_t capacity)
+      : lru(capacity) {}
+    
+    std::mutex mutex;
+    folly::EvictingCacheMap<uint64_t, Entry> lru;
+  };
+  
+  Shard& GetShard(const ZRpcRequestKey& key) {
+    return *shards_[key.hash % kShardCount];
+  }
+  
+  std::unique_ptr<Shard> shards_[kShardCount];
+};
+
+#endif
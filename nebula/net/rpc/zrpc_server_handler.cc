@@ -17,13 +17,96 @@
 
 #include "nebula/net/rpc/zrpc_server_handler.h"
 
+#include "nebula/net/base/socket_address_util.h"
+#include "nebula/net/rpc/zrpc_service_util.h"
+
 void ZRpcServerHandler::read(Context* ctx, PackageMessagePtr msg) {
   LOG(INFO) << "read - received data: "; // << msg;
-  auto received = std::static_pointer_cast<RpcRequest>(msg);
-  ctx->fireRead(received);
+  if (msg->GetPackageType() == Package::CONTAINER) {
+    // 客户端批量发送的请求, 逐个投递, 由dispatcher并发执行
+    // 客户端的流控credit也走批量写, 可能打包在Container里
+    auto container = std::static_pointer_cast<Container>(msg);
+    for (auto& v : container->data) {
+      if (v->GetPackageType() == Package::RPC_STREAM_CREDIT) {
+        OnStreamCredit(std::static_pointer_cast<RpcRequest>(v));
+        continue;
+      }
+      if (v->GetPackageType() != Package::RPC_REQUEST) {
+        LOG(ERROR) << "read - invalid package in container: " << static_cast<int>(v->GetPackageType());
+        continue;
+      }
+      OnRequest(ctx, std::static_pointer_cast<RpcRequest>(v));
+    }
+    return;
+  }
+  
+  if (msg->GetPackageType() == Package::RPC_STREAM_CREDIT) {
+    OnStreamCredit(std::static_pointer_cast<RpcRequest>(msg));
+    return;
+  }
+  
+  OnRequest(ctx, std::static_pointer_cast<RpcRequest>(msg));
+}
+
+void ZRpcServerHandler::OnRequest(Context* ctx, RpcRequestPtr request) {
+  // 超限直接应答RpcFloodWait, 不再往上投递
+  int32_t delay = 0;
+  if (!CheckRateLimit(request->GetMethodID(), &delay)) {
+    write(ctx, std::make_shared<RpcFloodWait>(request->message_id(), delay));
+    return;
+  }
+  
+  auto entry = ZRpcMethodTable::GetInstance().Find(request->method_id);
+  if (entry && entry->stream_func) {
+    OnStreamRequest(ctx, request);
+    return;
+  }
+  
+  ctx->fireRead(request);
+}
+
+void ZRpcServerHandler::OnStreamRequest(Context* ctx, RpcRequestPtr request) {
+  // 流式方法不经过dispatcher, 数据和结束包都由writer在IO线程里写出
+  auto message_id = request->message_id();
+  auto stream = std::make_shared<ZRpcStreamWriter>(ctx->getTransport()->getEventBase(),
+                                                   message_id,
+                                                   RpcStreamCredit::kDefaultStreamWindow,
+                                                   [this, ctx](ProtoRpcResponsePtr rsp) {
+                                                     write(ctx, rsp);
+                                                   },
+                                                   [this](int64_t req_message_id) {
+                                                     streams_.erase(req_message_id);
+                                                   });
+  streams_[message_id] = stream;
+  
+  ZRpcUtil::DoServiceCall(request, stream).then([stream](ProtoRpcResponsePtr rsp) {
+    stream->Finish(rsp);
+  });
+}
+
+void ZRpcServerHandler::OnStreamCredit(RpcRequestPtr credit) {
+  auto c = std::static_pointer_cast<RpcStreamCredit>(credit);
+  auto it = streams_.find(c->req_message_id);
+  if (it != streams_.end()) {
+    // AddCredits里可能写完结束包, finish回调会从streams_里删掉writer, 先持有一份
+    auto stream = it->second;
+    stream->AddCredits(c->credits);
+  }
+}
+
+void ZRpcServerHandler::CloseStreams() {
+  auto streams = std::move(streams_);
+  streams_.clear();
+  for (auto& v : streams) {
+    v.second->Close();
+  }
 }
 
 folly::Future<folly::Unit> ZRpcServerHandler::write(Context* ctx, ProtoRpcResponsePtr rsp) {
+  if (batch_writer_) {
+    return batch_writer_->Write(rsp);
+  }
+  
   std::unique_ptr<folly::IOBuf> out;
   rsp->SerializeToIOBuf(out);
   return ctx->fireWrite(std::move(out));
@@ -46,7 +129,17 @@ void ZRpcServerHandler::readException(Context* ctx, folly::exception_wrapper e)
 
 void ZRpcServerHandler::transportActive(Context* ctx) {
   auto pipeline = dynamic_cast<ZRpcServerPipeline*>(ctx->getPipeline());
-  OnNewConnection(pipeline, pipeline->getTransportInfo()->remoteAddr->getAddressStr());
+  OnNewConnection(pipeline, nebula::ToAddressString(*pipeline->getTransportInfo()->remoteAddr));
+  
+  auto& config = service_->GetServiceConfig();
+  if (config.batch_max_count > 1) {
+    batch_writer_.reset(new ZRpcBatchWriter(ctx->getTransport()->getEventBase(),
+                                            config.batch_max_count,
+                                            config.batch_window_ms,
+                                            [ctx](std::unique_ptr<folly::IOBuf> out) {
+                                              return ctx->fireWrite(std::move(out));
+                                            }));
+  }
   
   LOG(INFO) << "transportActive - conn_id = " << conn_id_
             << ", Connection connected by "
@@ -64,6 +157,8 @@ void ZRpcServerHandler::transportInactive(Context* ctx) {
             << remote_address_
             << ", conn_info: " << service_->GetServiceConfig().ToString();
   
+  CloseStreams();
+  batch_writer_.reset();
   OnConnectionClosed();
 }
 
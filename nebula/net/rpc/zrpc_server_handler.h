@@ -22,6 +22,8 @@
 
 #include "nebula/net/zproto/zproto_package_data.h"
 #include "nebula/net/handler/nebula_base_handler.h"
+#include "nebula/net/rpc/zrpc_batch_writer.h"
+#include "nebula/net/rpc/zrpc_stream.h"
 
 using ZRpcServerPipeline = wangle::Pipeline<folly::IOBufQueue&, ProtoRpcResponsePtr>;
 
@@ -44,6 +46,17 @@ public:
     virtual void transportInactive(Context* ctx) override;
 
     virtual folly::Future<folly::Unit> close(Context* ctx) override;
+  
+protected:
+    void OnRequest(Context* ctx, RpcRequestPtr request);
+    void OnStreamRequest(Context* ctx, RpcRequestPtr request);
+    void OnStreamCredit(RpcRequestPtr credit);
+    void CloseStreams();
+  
+    // 配置了batch_max_count才启用, 同一次事件循环里完成的应答合并写出
+    std::unique_ptr<ZRpcBatchWriter> batch_writer_;
+    // 未结束的流, req_message_id -> writer
+    std::unordered_map<int64_t, ZRpcStreamWriterPtr> streams_;
 };
 
 #endif
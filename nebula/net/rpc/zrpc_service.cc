@@ -17,6 +17,8 @@
 
 #include "nebula/net/rpc/zrpc_service.h"
 
+#include <folly/io/async/EventBaseManager.h>
+
 // #define DEBUG_TEST
 #ifdef DEBUG_TEST
 #include "proto/zproto/zproto_message_types_util.h"
@@ -24,12 +26,32 @@
 #endif
 
 #include "nebula/net/rpc/zrpc_service_util.h"
+#include "nebula/net/rpc/zrpc_latency_stats.h"
 
+ZRpcService::ZRpcService(const std::string& backend)
+  : backend_id_(ZRpcLatencyStats::GetInstance().GetBackendID(backend)) {
+}
 
 folly::Future<ProtoRpcResponsePtr> ZRpcService::operator()(RpcRequestPtr request) {
   LOG(INFO) << "ZRpcService - recv request: " << request->ToString();
   
-  return ZRpcUtil::DoServiceCall(request);
+  // 方法可能被投递到其它线程组执行，完成后切回到IO线程，由IO线程写回应答
+  auto evb = folly::EventBaseManager::get()->getExistingEventBase();
+  auto start = ZRpcLatencyStats::NowInUsec();
+  auto method_id = request->method_id;
+  auto backend_id = backend_id_;
+  auto f = ZRpcUtil::DoServiceCall(request).then([=](ProtoRpcResponsePtr r) {
+    ZRpcLatencyStats::GetInstance().Record(ZRpcSide::SERVER,
+                                           method_id,
+                                           backend_id,
+                                           r->GetPackageType(),
+                                           ZRpcLatencyStats::NowInUsec() - start);
+    return r;
+  });
+  if (evb && !f.isReady()) {
+    return std::move(f).via(evb);
+  }
+  return f;
   
   // Oh no, we got Bonked!  Quick, Bonk back
   // printf("Bonk: %s, %i\n", request.message.c_str(), request.type);
@@ -26,7 +26,13 @@
 
 class ZRpcService : public wangle::Service<RpcRequestPtr, ProtoRpcResponsePtr> {
 public:
+  // backend: 本服务的地址, 用于延时统计
+  explicit ZRpcService(const std::string& backend = "");
+  
   virtual folly::Future<ProtoRpcResponsePtr> operator()(RpcRequestPtr request) override;
+  
+private:
+  uint32_t backend_id_ {0};
 };
 
 /*
@@ -17,10 +17,13 @@
 
 #include "nebula/net/rpc/zrpc_service_util.h"
 
+#include <mutex>
+
 #include <folly/MoveWrapper.h>
+#include <folly/Random.h>
+#include <folly/futures/helpers.h>
 
 #include "nebula/base/id_util.h"
-#include "nebula/base/map_util.h"
 
 #include "nebula/net/base/nebula_pipeline.h"
 #include "nebula/net/thread_local_conn_manager.h"
@@ -28,13 +31,227 @@
 #include "nebula/net/net_engine_manager.h"
 
 #include "nebula/net/rpc/zrpc_client_handler.h"
+#include "nebula/net/rpc/zrpc_client_policy.h"
+#include "nebula/net/rpc/zrpc_response_cache.h"
+#include "nebula/net/rpc/zrpc_single_flight.h"
+#include "nebula/net/rpc/zrpc_latency_stats.h"
 
-std::map<int, ZRpcUtil::ServiceFunc> ZRpcUtil::g_rpc_services;
 // static ProtoRpcResponsePtr kEmptyResponse;
 
-folly::Future<ProtoRpcResponsePtr> ZRpcUtil::DoClientCall(const std::string& service_name, RpcRequestPtr request) {
-  CHECK(request);
+namespace {
+
+struct ZRpcClientConn {
+  std::shared_ptr<nebula::TcpClientGroupBase> group;
+  uint64_t conn_id {0};
+  std::shared_ptr<wangle::PipelineBase> pipeline;
+  ZRpcClientHandler* handler {nullptr};
+};
+
+// strict为true时跳过正在退避或被摘除的连接
+bool ToClientConn(const std::shared_ptr<nebula::TcpClientGroupBase>& group,
+                  const nebula::TcpClientGroupBase::OnlineTcpClient& client,
+                  uint64_t exclude_conn_id,
+                  int32_t method_id,
+                  bool strict,
+                  ZRpcClientConn* conn) {
+  if (client.first == exclude_conn_id) {
+    return false;
+  }
+  
+  auto pipeline = client.second.lock();
+  if (!pipeline) {
+    return false;
+  }
+  
+  auto handler = dynamic_cast<ZRpcClientPipeline*>(pipeline.get())->getHandler<ZRpcClientHandler>();
+  if (!handler) {
+    return false;
+  }
+  if (strict && (handler->IsFloodWaiting(method_id) || !group->IsBackendAvailable(client.first))) {
+    return false;
+  }
+  
+  conn->group = group;
+  conn->conn_id = client.first;
+  conn->pipeline = pipeline;
+  conn->handler = handler;
+  return true;
+}
+
+// 随机选一个在线连接, 跳过exclude_conn_id, 优先选method_id没有退避且未被摘除的连接
+// allow_fallback为true时, 所有连接都不可用也返回一个(退避中的由ZRpcClientFilter直接应答RpcFloodWait)
+bool PickClientConn(const std::shared_ptr<nebula::TcpClientGroupBase>& group,
+                    uint64_t exclude_conn_id,
+                    int32_t method_id,
+                    bool allow_fallback,
+                    ZRpcClientConn* conn) {
+  nebula::TcpClientGroupBase::OnlineTcpClient client;
+  if (!group->GetOnlineClientByRandom(&client)) {
+    return false;
+  }
+  if (ToClientConn(group, client, exclude_conn_id, method_id, true, conn)) {
+    return true;
+  }
+  
+  // 随机到的连接不可用, 从另一个随机位置开始往后找一个
+  // 不从头开始找, 否则被摘除连接的流量都压到排在最前面的健康连接上
+  nebula::TcpClientGroupBase::OnlineTcpClientList clients;
+  if (group->GetOnlineClients(&clients)) {
+    auto start = folly::Random::rand32(static_cast<uint32_t>(clients.size()));
+    for (size_t i = 0; i < clients.size(); ++i) {
+      if (ToClientConn(group, clients[(start + i) % clients.size()], exclude_conn_id, method_id, true, conn)) {
+        return true;
+      }
+    }
+  }
+  
+  return allow_fallback && ToClientConn(group, client, exclude_conn_id, method_id, false, conn);
+}
+
+folly::Future<ProtoRpcResponsePtr> CallClientConnInEventBase(const ZRpcClientConn& conn, RpcRequestPtr request) {
+  // dispatcher只能在连接所在的IO线程里访问, pipeline保证handler在切换线程期间有效
+  auto evb = conn.handler->GetEventBase();
+  if (!evb || evb->isInEventBaseThread()) {
+    return conn.handler->ServiceCall(request);
+  }
   
+  auto pipeline = conn.pipeline;
+  auto handler = conn.handler;
+  return folly::via(evb).then([pipeline, handler, request]() {
+    return handler->ServiceCall(request);
+  });
+}
+
+// 调用并上报后端健康状态
+folly::Future<ProtoRpcResponsePtr> CallClientConn(const ZRpcClientConn& conn, RpcRequestPtr request) {
+  auto group = conn.group;
+  auto conn_id = conn.conn_id;
+  auto start_time = ZRpcLatencyStats::NowInUsec();
+  return CallClientConnInEventBase(conn, request).then([group, conn_id, start_time](ProtoRpcResponsePtr rsp) {
+    // RpcFloodWait是过载保护, 不算失败
+    if (rsp->GetPackageType() != Package::RPC_FLOOD_WAIT) {
+      group->OnBackendResult(conn_id,
+                             rsp->GetPackageType() != Package::RPC_INTERNAL_ERROR,
+                             ZRpcLatencyStats::NowInUsec() - start_time);
+    }
+    return rsp;
+  });
+}
+
+// 是否可以换一个连接重发
+// RpcFloodWait是后端未执行直接拒绝的, 都可以重发
+// RpcInternalError(包括连接断开时未完成的请求)只有幂等方法可以重发
+bool IsRetryable(const ProtoRpcResponsePtr& rsp, bool idempotent) {
+  switch (rsp->GetPackageType()) {
+    case Package::RPC_FLOOD_WAIT:
+      return true;
+    case Package::RPC_INTERNAL_ERROR:
+      return idempotent;
+    default:
+      return false;
+  }
+}
+
+// 对冲请求的共享状态, 优先取成功的应答, 都失败则取最后一个
+struct ZRpcHedgeContext {
+  void SetResponse(ProtoRpcResponsePtr rsp) {
+    if (!IsRetryable(rsp, true)) {
+      Finish(std::move(rsp));
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> g(mutex);
+      last_error = std::move(rsp);
+    }
+    Release();
+  }
+  
+  // 一个请求结束, 或者准备发的对冲没有发出; 都结束了还没有成功的应答则返回最后一个失败应答
+  void Release() {
+    if (pending.fetch_sub(1) == 1) {
+      ProtoRpcResponsePtr rsp;
+      {
+        std::lock_guard<std::mutex> g(mutex);
+        rsp = last_error;
+      }
+      Finish(std::move(rsp));
+    }
+  }
+  
+  void Finish(ProtoRpcResponsePtr rsp) {
+    if (!done.exchange(true)) {
+      promise.setValue(std::move(rsp));
+    }
+  }
+  
+  std::atomic<bool> done {false};
+  std::atomic<int> pending {1};
+  std::mutex mutex;
+  ProtoRpcResponsePtr last_error;
+  folly::Promise<ProtoRpcResponsePtr> promise;
+};
+
+void CallClientConnHedged(const std::shared_ptr<ZRpcHedgeContext>& ctx,
+                          const ZRpcClientConn& conn,
+                          RpcRequestPtr request) {
+  auto req_message_id = request->message_id();
+  CallClientConn(conn, request).then([ctx](ProtoRpcResponsePtr rsp) {
+    ctx->SetResponse(std::move(rsp));
+  }).onError([ctx, req_message_id](const std::exception& e) {
+    LOG(ERROR) << "CallClientConnHedged - catch a threwn exception: " << folly::exceptionStr(e);
+    ctx->SetResponse(std::make_shared<RpcInternalError>(req_message_id));
+  });
+}
+
+// 先发给conn, 超过hedge_delay_us还未应答, 再发一份给另一个连接
+folly::Future<ProtoRpcResponsePtr> HedgedCall(const std::shared_ptr<nebula::TcpClientGroupBase>& group,
+                                              const ZRpcClientConn& conn,
+                                              RpcRequestPtr request,
+                                              uint64_t hedge_delay_us) {
+  auto ctx = std::make_shared<ZRpcHedgeContext>();
+  auto f = ctx->promise.getFuture();
+  CallClientConnHedged(ctx, conn, request);
+  
+  auto conn_id = conn.conn_id;
+  // 定时器到期后切回第一个连接的IO线程再选连接, 不占用timekeeper线程
+  auto evb = conn.handler->GetEventBase();
+  auto hedge = [ctx, group, conn_id, request]() {
+    // 先占住对冲请求的计数再检查done, 否则第一个失败应答可能在两者之间提前结束调用
+    ctx->pending.fetch_add(1);
+    if (ctx->done.load()) {
+      ctx->Release();
+      return;
+    }
+    
+    ZRpcClientConn other;
+    if (!PickClientConn(group, conn_id, request->method_id, false, &other)) {
+      ctx->Release();
+      return;
+    }
+    // 两个连接在不同的IO线程里并发序列化, 不能共用同一个请求对象
+    auto hedge_request = request->Clone();
+    if (!hedge_request || !ZRpcRetryBudget::GetInstance().TryRetry()) {
+      ctx->Release();
+      return;
+    }
+    
+    CallClientConnHedged(ctx, other, hedge_request);
+  };
+  
+  auto sleep = folly::futures::sleep(std::chrono::milliseconds(hedge_delay_us / 1000));
+  if (evb) {
+    sleep.via(evb).then(hedge);
+  } else {
+    sleep.then(hedge);
+  }
+  
+  return f;
+}
+
+// 选一个连接发送, 按方法选项重发或对冲
+folly::Future<ProtoRpcResponsePtr> CallClientGroup(const std::string& service_name,
+                                                   RpcRequestPtr request,
+                                                   const ZRpcClientMethodEntry* method) {
   // TODO(@benqi): 移入tcp_client_group_util.h里
   auto net_engine = nebula::NetEngineManager::GetInstance();
   // auto& conn_manager = nebula::GetConnManagerByThreadLocal();
@@ -42,48 +259,297 @@ folly::Future<ProtoRpcResponsePtr> ZRpcUtil::DoClientCall(const std::string& ser
   auto service = net_engine->Lookup(service_name);
   if (!service) {
     LOG(ERROR) << "Write - invalid error, not find service_name: " << service_name;
-    return folly::makeFuture(std::make_shared<RpcInternalError>(request->message_id()));
+    return folly::makeFuture<ProtoRpcResponsePtr>(std::make_shared<RpcInternalError>(request->message_id()));
   }
   
   auto group = std::static_pointer_cast<nebula::TcpClientGroupBase>(service);
-  nebula::TcpClientGroupBase::OnlineTcpClient client;
-  if (!group->GetOnlineClientByRandom(&client)) {
+  ZRpcClientConn conn;
+  if (!PickClientConn(group, 0, request->method_id, true, &conn)) {
     LOG(ERROR) << "Write - invalid error, not online client's service_name: " << service_name;
-    return folly::makeFuture(std::make_shared<RpcInternalError>(request->message_id()));
+    return folly::makeFuture<ProtoRpcResponsePtr>(std::make_shared<RpcInternalError>(request->message_id()));
   }
   
-  auto pipeline = client.second.lock();
-  if (!pipeline) {
-    LOG(ERROR) << "Write - invalid error, not online client's service_name: " << service_name;
-    return folly::makeFuture(std::make_shared<RpcInternalError>(request->message_id()));
+  auto& retry_budget = ZRpcRetryBudget::GetInstance();
+  retry_budget.OnRequest();
+  
+  bool idempotent = method && method->option.idempotent;
+  
+  auto conn_id = conn.conn_id;
+  auto f = (method && method->option.hedge) ?
+      HedgedCall(group, conn, request, method->GetHedgeDelay()) :
+      CallClientConn(conn, request);
+  
+  return f.then([group, conn_id, request, idempotent](ProtoRpcResponsePtr rsp) {
+    if (!IsRetryable(rsp, idempotent)) {
+      return folly::makeFuture(rsp);
+    }
+    
+    // 后端过载或连接断开, 换一个没有退避的后端重试一次
+    ZRpcClientConn other;
+    if (!PickClientConn(group, conn_id, request->method_id, false, &other)) {
+      return folly::makeFuture(rsp);
+    }
+    if (!ZRpcRetryBudget::GetInstance().TryRetry()) {
+      LOG(WARNING) << "DoClientCall - retry budget exhausted, method_id: " << request->method_id;
+      return folly::makeFuture(rsp);
+    }
+    return CallClientConn(other, request);
+  });
+}
+
+// 客户端服务配置了local_call, 且方法已在本进程注册(非流式)
+// 对冲的方法走网络: 本进程只有一个后端, 没有可以对冲的
+bool IsLocalCall(const std::string& service_name, int method_id, const ZRpcClientMethodEntry* method) {
+  if (method && method->option.hedge) {
+    return false;
   }
+  auto service = nebula::NetEngineManager::GetInstance()->Lookup(service_name);
+  if (!service || !service->GetServiceConfig().local_call) {
+    return false;
+  }
+  return ZRpcMethodTable::GetInstance().HasUnaryMethod(method_id);
+}
+
+folly::Future<ProtoRpcResponsePtr> CallServiceFunc(const ZRpcMethodEntry* entry,
+                                                   RpcRequestPtr request,
+                                                   ZRpcStreamWriterPtr stream) {
+  auto req_message_id = request->message_id();
+  return folly::makeFutureWith([entry, &request, &stream]() {
+    if (entry->func) {
+      return folly::makeFuture(entry->func(request));
+    } else if (entry->async_func) {
+      return entry->async_func(request);
+    } else if (!stream) {
+      LOG(ERROR) << "ServiceCall - stream method called without stream, method_id: " << entry->method_id;
+      return folly::makeFuture<ProtoRpcResponsePtr>(nullptr);
+    }
+    return entry->stream_func(request, stream);
+  }).then([req_message_id](ProtoRpcResponsePtr r) -> ProtoRpcResponsePtr {
+    if (!r) {
+      LOG(ERROR) << "ServiceCall - response is nil, req_message_id: " << req_message_id;
+      return std::make_shared<RpcInternalError>(req_message_id);
+    }
+    r->set_message_id(GetNextIDBySnowflake());
+    return r;
+  }).onError([req_message_id](const std::exception& e) -> ProtoRpcResponsePtr {
+    LOG(ERROR) << "ServiceCall - catch a threwn exception: " << folly::exceptionStr(e)
+                << ", req_message_id: " << req_message_id;
+    return std::make_shared<RpcInternalError>(req_message_id);
+  });
+}
+
+}
+
+
+folly::Future<ProtoRpcResponsePtr> ZRpcUtil::DoClientCall(const std::string& service_name, RpcRequestPtr request) {
+  CHECK(request);
   
-  auto handler = dynamic_cast<ZRpcClientPipeline*>(pipeline.get())->getHandler<ZRpcClientHandler>();
+  // 调用方看到的message_id, 所有路径(缓存、本地调用、出错)的应答req_message_id都是它
+  // 发送时dispatcher另外分配连接内的id, 不修改这个请求
+  if (request->message_id() == 0) {
+    request->set_message_id(GetNextIDBySnowflake());
+  }
+  
+  auto method = ZRpcClientMethodTable::GetInstance().Find(request->method_id);
+  if (!method || (method->option.cache_ttl_ms == 0 && !method->option.single_flight)) {
+    return CallService(service_name, request, method);
+  }
+  
+  // 相同请求在有效期内直接返回缓存的应答
+  auto key = ZRpcRequestKey::Make(service_name, request, method->option.cache_shared);
+  auto ttl_ms = method->option.cache_ttl_ms;
+  if (ttl_ms > 0) {
+    auto cached = ZRpcResponseCache::GetInstance().Get(key, request->message_id());
+    if (cached) {
+      return folly::makeFuture(cached);
+    }
+  }
+  
+  auto call = [service_name, request, method, key, ttl_ms]() {
+    auto f = CallService(service_name, request, method);
+    if (ttl_ms == 0) {
+      return f;
+    }
+    return f.then([key, ttl_ms](ProtoRpcResponsePtr rsp) {
+      ZRpcResponseCache::GetInstance().Put(key, rsp, ttl_ms);
+      return rsp;
+    });
+  };
   
-  // TODO(@benqi): 线程同步
-  return handler->ServiceCall(request);
+  // 缓存未命中时相同的并发请求只发一个
+  if (method->option.single_flight) {
+    return ZRpcSingleFlight::GetInstance().Do(key, request->message_id(), call);
+  }
+  return call();
 }
 
-void ZRpcUtil::Register(int method_id, ServiceFunc f) {
-  if (ContainsKey(g_rpc_services, method_id)) {
-    LOG(ERROR) << "Register - duplicate entry for method_id: " << method_id;
-  } else {
-    g_rpc_services.emplace(method_id, f);
+folly::Future<ProtoRpcResponsePtr> ZRpcUtil::CallService(const std::string& service_name,
+                                                        RpcRequestPtr request,
+                                                        const ZRpcClientMethodEntry* method) {
+  if (!IsLocalCall(service_name, request->method_id, method)) {
+    return CallClientGroup(service_name, request, method);
+  }
+  
+  ZRpcRetryBudget::GetInstance().OnRequest();
+  bool idempotent = method && method->option.idempotent;
+  return DoLocalCall(request).then([service_name, request, method, idempotent](ProtoRpcResponsePtr rsp) {
+    if (!IsRetryable(rsp, idempotent) || !ZRpcRetryBudget::GetInstance().TryRetry()) {
+      return folly::makeFuture(rsp);
+    }
+    // 本进程过载, 换网络上的后端重试
+    return CallClientGroup(service_name, request, method);
+  });
+}
+
+folly::Future<ProtoRpcResponsePtr> ZRpcUtil::DoLocalCall(RpcRequestPtr request) {
+  // 请求和应答都按网络格式编解码一次, 服务端拿到EncodedRpcRequest, 客户端拿到EncodedRpcOk等,
+  // 和走网络时一样, 不共享调用方的对象
+  auto req_message_id = request->message_id();
+  auto local_request = std::dynamic_pointer_cast<RpcRequest>(RecodePackageMessage(*request));
+  if (!local_request) {
+    LOG(ERROR) << "DoLocalCall - recode request error, method_id: " << request->method_id;
+    return folly::makeFuture<ProtoRpcResponsePtr>(std::make_shared<RpcInternalError>(req_message_id));
   }
+  
+  return DoServiceCall(local_request).then([req_message_id](ProtoRpcResponsePtr rsp) -> ProtoRpcResponsePtr {
+    auto local_rsp = std::dynamic_pointer_cast<ProtoRpcResponse>(RecodePackageMessage(*rsp));
+    if (!local_rsp) {
+      LOG(ERROR) << "DoLocalCall - recode response error, req_message_id: " << req_message_id;
+      return std::make_shared<RpcInternalError>(req_message_id);
+    }
+    return local_rsp;
+  });
 }
 
-ProtoRpcResponsePtr ZRpcUtil::DoServiceCall(RpcRequestPtr request) {
+folly::Future<ZRpcClientStreamPtr> ZRpcUtil::DoClientStreamCall(const std::string& service_name, RpcRequestPtr request) {
   CHECK(request);
   
-  auto it = g_rpc_services.find(request->method_id);
-  if (it != g_rpc_services.end()) {
-    auto r = (it->second)(request);
-    r->set_message_id(GetNextIDBySnowflake());
-    return r;
-    //(it->second)(request);
-  } else {
-    LOG(ERROR) << "ServiceCall - Not register request: " << request->ToString();
-    return std::make_shared<RpcInternalError>(request->message_id());
+  if (request->message_id() == 0) {
+    request->set_message_id(GetNextIDBySnowflake());
+  }
+  
+  // 失败时返回一个已结束的流
+  auto make_error_stream = [](int64_t req_message_id) {
+    auto stream = std::make_shared<ZRpcClientStream>(req_message_id, 0, nullptr);
+    stream->OnFinish(std::make_shared<RpcInternalError>(req_message_id));
+    return stream;
+  };
+  
+  auto service = nebula::NetEngineManager::GetInstance()->Lookup(service_name);
+  if (!service) {
+    LOG(ERROR) << "DoClientStreamCall - invalid error, not find service_name: " << service_name;
+    return folly::makeFuture<ZRpcClientStreamPtr>(make_error_stream(request->message_id()));
+  }
+  
+  auto group = std::static_pointer_cast<nebula::TcpClientGroupBase>(service);
+  ZRpcClientConn conn;
+  if (!PickClientConn(group, 0, request->method_id, false, &conn)) {
+    LOG(ERROR) << "DoClientStreamCall - invalid error, not online client's service_name: " << service_name;
+    return folly::makeFuture<ZRpcClientStreamPtr>(make_error_stream(request->message_id()));
   }
+  
+  // dispatcher只能在连接所在的IO线程里访问
+  auto pipeline = conn.pipeline;
+  auto handler = conn.handler;
+  return folly::via(handler->GetEventBase()).then([pipeline, handler, request, make_error_stream]() {
+    auto stream = handler->StreamCall(request);
+    return stream ? stream : make_error_stream(request->message_id());
+  });
+}
+
+void ZRpcUtil::RegisterClient(int method_id, const ZRpcClientMethodOption& option) {
+  ZRpcClientMethodTable::GetInstance().Register(method_id, option);
+}
+
+void ZRpcUtil::Register(int method_id, ServiceFunc f) {
+  Register(method_id, f, ZRpcMethodOption(ZRpcExecType::CPU));
+}
+
+void ZRpcUtil::Register(int method_id, ServiceFunc f, const ZRpcMethodOption& option) {
+  ZRpcMethodEntry entry;
+  entry.method_id = method_id;
+  entry.func = f;
+  entry.option = option;
+  ZRpcMethodTable::GetInstance().Register(std::move(entry));
+}
+
+void ZRpcUtil::RegisterAsync(int method_id, AsyncServiceFunc f, const ZRpcMethodOption& option) {
+  ZRpcMethodEntry entry;
+  entry.method_id = method_id;
+  entry.async_func = f;
+  entry.option = option;
+  ZRpcMethodTable::GetInstance().Register(std::move(entry));
+}
+
+void ZRpcUtil::RegisterStream(int method_id, StreamServiceFunc f, const ZRpcMethodOption& option) {
+  ZRpcMethodEntry entry;
+  entry.method_id = method_id;
+  entry.stream_func = f;
+  entry.option = option;
+  ZRpcMethodTable::GetInstance().Register(std::move(entry));
 }
 
+void ZRpcUtil::GetMethodStats(std::vector<ZRpcMethodStats>* stats) {
+  ZRpcMethodTable::GetInstance().GetStats(stats);
+}
+
+folly::Future<ProtoRpcResponsePtr> ZRpcUtil::DoServiceCall(RpcRequestPtr request, ZRpcStreamWriterPtr stream) {
+  CHECK(request);
+  
+  auto entry = ZRpcMethodTable::GetInstance().Find(request->method_id);
+  if (!entry) {
+    LOG(ERROR) << "ServiceCall - Not register request: " << request->ToString();
+    return folly::makeFuture<ProtoRpcResponsePtr>(std::make_shared<RpcInternalError>(request->message_id()));
+  }
+  
+  entry->OnCallStart(request->CalcPackageSize());
+  
+  folly::Future<ProtoRpcResponsePtr> f = folly::makeFuture<ProtoRpcResponsePtr>(nullptr);
+  auto executor = entry->executor;
+  auto admission = entry->admission.get();
+  auto now = ZRpcLatencyStats::NowInUsec();
+  if (!admission->Admit(executor != nullptr)) {
+    // 过载, 直接拒绝, 不再执行
+    LOG(ERROR) << "ServiceCall - overload, method_id: " << request->method_id
+                << ", in_flight: " << admission->in_flight()
+                << ", queue_size: " << admission->queue_size()
+                << ", overloaded: " << admission->overloaded();
+    auto r = std::make_shared<RpcFloodWait>(request->message_id(), entry->option.flood_wait_delay);
+    entry->OnCallEnd(r);
+    return folly::makeFuture<ProtoRpcResponsePtr>(r);
+  }
+  
+  if (!executor) {
+    // 在IO线程里直接执行
+    f = CallServiceFunc(entry, request, stream);
+  } else {
+    // 投递到线程组
+    // 线程组add失败(比如已关闭)时不会执行下面的回调, 由最后的then统一收尾
+    auto dequeued = std::make_shared<bool>(false);
+    f = folly::via(executor).then([entry, request, stream, now, dequeued]() {
+      *dequeued = true;
+      auto dequeue_time = ZRpcLatencyStats::NowInUsec();
+      entry->admission->OnDequeue(dequeue_time - now, dequeue_time);
+      return CallServiceFunc(entry, request, stream);
+    }).ensure([entry, dequeued]() {
+      if (!*dequeued) {
+        entry->admission->OnDropped();
+      }
+    });
+  }
+  
+  auto req_message_id = request->message_id();
+  return f.then([entry, req_message_id](folly::Try<ProtoRpcResponsePtr>&& t) {
+    ProtoRpcResponsePtr r;
+    if (t.hasException()) {
+      LOG(ERROR) << "ServiceCall - catch a threwn exception: " << t.exception().what()
+                  << ", req_message_id: " << req_message_id;
+      r = std::make_shared<RpcInternalError>(req_message_id);
+    } else {
+      r = std::move(t.value());
+    }
+    entry->admission->OnComplete();
+    entry->OnCallEnd(r);
+    return r;
+  });
+}
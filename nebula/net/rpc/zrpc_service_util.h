@@ -18,24 +18,56 @@
 #ifndef NEBULA_NET_RPC_ZRPC_SERVICE_UTIL_H_
 #define NEBULA_NET_RPC_ZRPC_SERVICE_UTIL_H_
 
+#include <vector>
+
 #include <folly/futures/Future.h>
 
 #include "nebula/net/zproto/zproto_package_data.h"
+#include "nebula/net/rpc/zrpc_method_table.h"
+#include "nebula/net/rpc/zrpc_client_policy.h"
 
 // ZRpc帮助类
 struct ZRpcUtil {
-  using  ServiceFunc = std::function<ProtoRpcResponsePtr(RpcRequestPtr)>;
+  using  ServiceFunc = ZRpcMethodEntry::ServiceFunc;
+  using  AsyncServiceFunc = ZRpcMethodEntry::AsyncServiceFunc;
+  using  StreamServiceFunc = ZRpcMethodEntry::StreamServiceFunc;
 
+  // 幂等方法失败时换连接重发, 开启对冲的方法超过p95未应答时再发给另一个后端
+  // 重发和对冲都受全局重试预算限制, 设置了cache_ttl_ms的方法优先查应答缓存,
+  // 设置了single_flight的方法合并相同的并发请求
+  // 客户端服务配置了local_call且方法在本进程已注册时不走网络(对冲的方法除外),
+  // 请求和应答仍按网络格式编解码, 缓存、合并和重发同样生效
   static folly::Future<ProtoRpcResponsePtr> DoClientCall(const std::string& service_name, RpcRequestPtr request);
+  // 流式调用, 不重发也不对冲
+  static folly::Future<ZRpcClientStreamPtr> DoClientStreamCall(const std::string& service_name, RpcRequestPtr request);
+  
+  // 客户端方法选项, 未注册的方法不重发(RpcFloodWait除外)、不对冲也不缓存
+  static void RegisterClient(int method_id, const ZRpcClientMethodOption& option);
+  
+  // 同步方法, 不指定option时投递到CPU线程组执行, 不阻塞IO线程
+  // 确定不阻塞的方法可以指定ZRpcExecType::INLINE
   static void Register(int method_id, ServiceFunc f);
+  static void Register(int method_id, ServiceFunc f, const ZRpcMethodOption& option);
+  // 异步方法, 返回的Future可以在任意线程里完成
+  static void RegisterAsync(int method_id, AsyncServiceFunc f, const ZRpcMethodOption& option = ZRpcMethodOption());
+  // 流式方法
+  static void RegisterStream(int method_id, StreamServiceFunc f, const ZRpcMethodOption& option = ZRpcMethodOption());
+  
+  // 服务端各方法的调用统计
+  static void GetMethodStats(std::vector<ZRpcMethodStats>* stats);
   
   // static ProtoRpcResponsePtr MakeInternal
 protected:
   friend class ZRpcService;
-  static ProtoRpcResponsePtr DoServiceCall(RpcRequestPtr request);
+  friend class ZRpcServerHandler;
+  // stream不为空时执行流式方法
+  static folly::Future<ProtoRpcResponsePtr> DoServiceCall(RpcRequestPtr request, ZRpcStreamWriterPtr stream = nullptr);
   
-  // TODO(@benqi): 使用FuncFactoryManager
-  static std::map<int, ServiceFunc> g_rpc_services;
+  // 本地调用或者发给客户端分组
+  static folly::Future<ProtoRpcResponsePtr> CallService(const std::string& service_name,
+                                                        RpcRequestPtr request,
+                                                        const ZRpcClientMethodEntry* method);
+  static folly::Future<ProtoRpcResponsePtr> DoLocalCall(RpcRequestPtr request);
 };
 
 #endif
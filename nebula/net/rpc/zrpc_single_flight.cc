@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/rpc/zrpc_single_flight.h"
+
+ZRpcSingleFlight& ZRpcSingleFlight::GetInstance() {
+  static ZRpcSingleFlight g_single_flight;
+  return g_single_flight;
+}
+
+folly::Future<ProtoRpcResponsePtr> ZRpcSingleFlight::Do(const ZRpcRequestKey& key, int64_t req_message_id, CallFunc call) {
+  if (!key.valid) {
+    return call();
+  }
+  
+  auto flight = std::make_shared<Flight>();
+  auto& shard = GetShard(key);
+  {
+    std::lock_guard<std::mutex> g(shard.mutex);
+    auto range = shard.flights.equal_range(key.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (key.IsSameRequest(it->second->key)) {
+        // 应答对象归发起请求的调用方, 等待的调用方各拿一份副本
+        return it->second->promise.getFuture().then([req_message_id](ProtoRpcResponsePtr rsp) {
+          auto copy = rsp ? rsp->Clone() : nullptr;
+          if (!copy) {
+            return rsp;
+          }
+          copy->set_req_message_id(req_message_id);
+          return copy;
+        });
+      }
+    }
+    
+    flight->key = key;
+    shard.flights.emplace(key.hash, flight);
+  }
+  
+  auto f = flight->promise.getFuture();
+  folly::makeFutureWith(call).then([this, flight](folly::Try<ProtoRpcResponsePtr>&& t) {
+    // 先移除再完成, 之后到达的请求重新发送
+    Remove(flight);
+    flight->promise.setTry(std::move(t));
+  });
+  return f;
+}
+
+void ZRpcSingleFlight::Remove(const std::shared_ptr<Flight>& flight) {
+  auto& shard = GetShard(flight->key);
+  std::lock_guard<std::mutex> g(shard.mutex);
+  auto range = shard.flights.equal_range(flight->key.hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == flight) {
+      shard.flights.erase(it);
+      return;
+    }
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_RPC_ZRPC_SINGLE_FLIGHT_H_
+#define NEBULA_NET_RPC_ZRPC_SINGLE_FLIGHT_H_
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <folly/futures/SharedPromise.h>
+
+#include "nebula/net/rpc/zrpc_response_cache.h"
+
+// 合并相同的并发请求
+// 同一时刻相同method_id和payload的请求只发一个, 其它调用等待同一个应答,
+// 各自拿到一份带自己req_message_id的副本(见ProtoRpcResponse::Clone)
+class ZRpcSingleFlight {
+public:
+  using CallFunc = std::function<folly::Future<ProtoRpcResponsePtr>()>;
+  
+  static ZRpcSingleFlight& GetInstance();
+  
+  // 没有相同的请求在途时执行call, 否则等待在途请求的应答
+  //  req_message_id: 本次调用的请求message_id
+  folly::Future<ProtoRpcResponsePtr> Do(const ZRpcRequestKey& key, int64_t req_message_id, CallFunc call);
+  
+private:
+  ZRpcSingleFlight() = default;
+  
+  enum {
+    kShardCount = 16,
+  };
+  
+  struct Flight {
+    ZRpcRequestKey key;
+    folly::SharedPromise<ProtoRpcResponsePtr> promise;
+  };
+  
+  struct Shard {
+    std::mutex mutex;
+    // 哈希冲突时同一个key下有多个Flight
+    std::unordered_multimap<uint64_t, std::shared_ptr<Flight>> flights;
+  };
+  
+  void Remove(const std::shared_ptr<Flight>& flight);
+  
+  Shard& GetShard(const ZRpcRequestKey& key) {
+    return shards_[key.hash % kShardCount];
+  }
+  
+  Shard shards_[kShardCount];
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nebula/net/rpc/zrpc_stream.h"
+
+ZRpcStreamWriter::ZRpcStreamWriter(folly::EventBase* evb,
+                                   int64_t req_message_id,
+                                   uint32_t credits,
+                                   WriteFunc write_func,
+                                   FinishFunc finish_func)
+  : evb_(evb),
+    req_message_id_(req_message_id),
+    credits_(credits),
+    write_func_(write_func),
+    finish_func_(finish_func) {
+}
+
+folly::Future<folly::Unit> ZRpcStreamWriter::Write(std::unique_ptr<folly::IOBuf> payload) {
+  auto promise = std::make_shared<folly::Promise<folly::Unit>>();
+  auto f = promise->getFuture();
+  
+  auto push = std::make_shared<RpcStreamPush>();
+  push->req_message_id = req_message_id_;
+  push->message.SwapPayload(payload);
+  
+  auto self = shared_from_this();
+  evb_->runInEventBaseThread([self, push, promise]() {
+    if (self->closed_ || self->terminal_) {
+      promise->setException(std::runtime_error("ZRpcStreamWriter - stream closed"));
+      return;
+    }
+    push->seq = self->next_seq_++;
+    self->pending_.push_back(PendingPush{push, promise});
+    self->Drain();
+  });
+  
+  return f;
+}
+
+void ZRpcStreamWriter::Finish(ProtoRpcResponsePtr terminal) {
+  auto self = shared_from_this();
+  evb_->runInEventBaseThread([self, terminal]() {
+    if (self->closed_ || self->terminal_) {
+      return;
+    }
+    self->terminal_ = terminal;
+    self->Drain();
+  });
+}
+
+void ZRpcStreamWriter::AddCredits(uint32_t credits) {
+  credits_ += credits;
+  Drain();
+}
+
+void ZRpcStreamWriter::Close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  
+  auto pending = std::move(pending_);
+  pending_.clear();
+  for (auto& v : pending) {
+    v.promise->setException(std::runtime_error("ZRpcStreamWriter - connection closed"));
+  }
+  
+  write_func_ = nullptr;
+  finish_func_ = nullptr;
+}
+
+void ZRpcStreamWriter::Drain() {
+  while (!closed_ && credits_ > 0 && !pending_.empty()) {
+    auto v = std::move(pending_.front());
+    pending_.pop_front();
+    --credits_;
+    
+    write_func_(v.push);
+    v.promise->setValue();
+  }
+  
+  // 数据都已发出再发结束包
+  if (!closed_ && terminal_ && pending_.empty()) {
+    terminal_->set_req_message_id(req_message_id_);
+    write_func_(terminal_);
+    
+    auto finish_func = std::move(finish_func_);
+    closed_ = true;
+    write_func_ = nullptr;
+    if (finish_func) {
+      finish_func(req_message_id_);
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+ZRpcClientStream::ZRpcClientStream(int64_t req_message_id, uint32_t window, CreditFunc credit_func)
+  : req_message_id_(req_message_id),
+    window_(window),
+    credit_func_(credit_func) {
+}
+
+folly::Future<ProtoRpcResponsePtr> ZRpcClientStream::Next() {
+  ProtoRpcResponsePtr rsp;
+  uint32_t credits = 0;
+  {
+    std::lock_guard<std::mutex> g(mutex_);
+    if (!ready_.empty()) {
+      rsp = ready_.front();
+      ready_.pop_front();
+    } else if (terminal_) {
+      return folly::makeFuture(terminal_);
+    } else {
+      waiters_.emplace_back();
+      return waiters_.back().getFuture();
+    }
+    
+    // 消费了半个窗口就补充credit
+    if (++consumed_ >= window_ / 2 && !terminal_) {
+      credits = consumed_;
+      consumed_ = 0;
+    }
+  }
+  
+  if (credits > 0) {
+    credit_func_(credits);
+  }
+  return folly::makeFuture(rsp);
+}
+
+void ZRpcClientStream::OnPush(ProtoRpcResponsePtr push) {
+  folly::Promise<ProtoRpcResponsePtr> waiter;
+  uint32_t credits = 0;
+  {
+    std::lock_guard<std::mutex> g(mutex_);
+    if (terminal_) {
+      return;
+    }
+    if (waiters_.empty()) {
+      ready_.push_back(push);
+      return;
+    }
+    
+    waiter = std::move(waiters_.front());
+    waiters_.pop_front();
+    if (++consumed_ >= window_ / 2) {
+      credits = consumed_;
+      consumed_ = 0;
+    }
+  }
+  
+  if (credits > 0) {
+    credit_func_(credits);
+  }
+  waiter.setValue(push);
+}
+
+void ZRpcClientStream::OnFinish(ProtoRpcResponsePtr terminal) {
+  std::deque<folly::Promise<ProtoRpcResponsePtr>> waiters;
+  {
+    std::lock_guard<std::mutex> g(mutex_);
+    if (terminal_) {
+      return;
+    }
+    terminal_ = terminal;
+    waiters.swap(waiters_);
+  }
+  
+  // 有等待者说明ready_为空
+  for (auto& v : waiters) {
+    v.setValue(terminal);
+  }
+}
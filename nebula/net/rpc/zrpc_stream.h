@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NEBULA_NET_RPC_ZRPC_STREAM_H_
+#define NEBULA_NET_RPC_ZRPC_STREAM_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <folly/futures/Future.h>
+#include <folly/io/async/EventBase.h>
+
+#include "nebula/net/zproto/zproto_package_data.h"
+
+// 服务端流写入器
+// Write/Finish可以在任意线程里调用, 内部状态只在连接所在的IO线程里访问
+// credit用完后Write返回的Future会等到客户端补充credit并发出后才完成,
+// 生产者按Future串行写即可得到背压
+class ZRpcStreamWriter : public std::enable_shared_from_this<ZRpcStreamWriter> {
+public:
+  using WriteFunc = std::function<void(ProtoRpcResponsePtr)>;
+  using FinishFunc = std::function<void(int64_t)>;
+  
+  // write_func: 在IO线程里写出一个包
+  // finish_func: 结束包写出后回调, 由连接移除该流
+  ZRpcStreamWriter(folly::EventBase* evb,
+                   int64_t req_message_id,
+                   uint32_t credits,
+                   WriteFunc write_func,
+                   FinishFunc finish_func);
+  
+  int64_t GetReqMessageID() const {
+    return req_message_id_;
+  }
+  
+  // 流已结束或连接已断开时返回异常
+  folly::Future<folly::Unit> Write(std::unique_ptr<folly::IOBuf> payload);
+  
+  // 以terminal(RpcOk/RpcError等)结束流, 排在所有未发出的数据之后
+  void Finish(ProtoRpcResponsePtr terminal);
+  
+  // 以下只能在IO线程里调用
+  void AddCredits(uint32_t credits);
+  // 连接断开, 未发出的数据全部失败
+  void Close();
+  
+private:
+  struct PendingPush {
+    std::shared_ptr<RpcStreamPush> push;
+    std::shared_ptr<folly::Promise<folly::Unit>> promise;
+  };
+  
+  void Drain();
+  
+  folly::EventBase* evb_;
+  int64_t req_message_id_;
+  
+  // IO线程里访问
+  uint32_t credits_;
+  uint32_t next_seq_ {0};
+  bool closed_ {false};
+  std::deque<PendingPush> pending_;
+  ProtoRpcResponsePtr terminal_;
+  WriteFunc write_func_;
+  FinishFunc finish_func_;
+};
+
+using ZRpcStreamWriterPtr = std::shared_ptr<ZRpcStreamWriter>;
+
+// 客户端流
+// 通过Next()依次取服务端返回的包, 线程安全
+// 返回RpcStreamPush为数据, 返回其它应答(RpcOk/RpcError/RpcInternalError等)表示流已结束,
+// 结束后再调用Next()仍返回结束包
+class ZRpcClientStream {
+public:
+  // 消费了credits个数据后调用, 由dispatcher在IO线程里补充credit
+  using CreditFunc = std::function<void(uint32_t)>;
+  
+  ZRpcClientStream(int64_t req_message_id, uint32_t window, CreditFunc credit_func);
+  
+  int64_t GetReqMessageID() const {
+    return req_message_id_;
+  }
+  
+  folly::Future<ProtoRpcResponsePtr> Next();
+  
+  // 以下由dispatcher在IO线程里调用
+  void OnPush(ProtoRpcResponsePtr push);
+  void OnFinish(ProtoRpcResponsePtr terminal);
+  
+private:
+  int64_t req_message_id_;
+  uint32_t window_;
+  CreditFunc credit_func_;
+  
+  std::mutex mutex_;
+  std::deque<ProtoRpcResponsePtr> ready_;
+  std::deque<folly::Promise<ProtoRpcResponsePtr>> waiters_;
+  ProtoRpcResponsePtr terminal_;
+  uint32_t consumed_ {0};
+};
+
+using ZRpcClientStreamPtr = std::shared_ptr<ZRpcClientStream>;
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// BackendHealthTracker:
+//  1. 连续失败达到consecutive_errors摘除, 受max_ejection_percent限制
+//  2. 多线程上报结果时连接建立/关闭不影响查找
+//  3. ToString带上所有配置项
+
+// 测试里assert始终生效
+#undef NDEBUG
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "nebula/net/base/backend_health.h"
+
+using namespace nebula;
+
+void TestConsecutiveErrors() {
+  BackendHealthOption option;
+  option.consecutive_errors = 3;
+  option.error_rate = 0;
+  option.latency_factor = 0;
+  option.max_ejection_percent = 0.5;
+  BackendHealthTracker tracker(option);
+  
+  for (uint64_t conn_id = 1; conn_id <= 4; ++conn_id) {
+    tracker.OnConnected(conn_id);
+  }
+  
+  tracker.OnResult(1, false, 100);
+  tracker.OnResult(1, false, 100);
+  assert(tracker.IsAvailable(1));
+  tracker.OnResult(1, false, 100);
+  assert(!tracker.IsAvailable(1));
+  
+  // 4个后端最多摘除2个
+  for (uint64_t conn_id = 2; conn_id <= 4; ++conn_id) {
+    for (int i = 0; i < 3; ++i) {
+      tracker.OnResult(conn_id, false, 100);
+    }
+  }
+  std::vector<BackendHealthStats> stats;
+  tracker.GetStats(&stats);
+  int ejected = 0;
+  for (auto& s : stats) {
+    if (s.ejected) ++ejected;
+  }
+  assert(ejected == 2);
+  
+  // 未知连接不拦
+  assert(tracker.IsAvailable(100));
+  
+  std::cout << "TestConsecutiveErrors> ok" << std::endl;
+}
+
+void TestConcurrentResult() {
+  BackendHealthOption option;
+  option.interval_ms = 1;
+  BackendHealthTracker tracker(option);
+  std::atomic<bool> stop {false};
+  
+  std::vector<std::thread> reporters;
+  for (int r = 0; r < 4; ++r) {
+    reporters.emplace_back([&, r]() {
+      uint64_t n = 0;
+      while (!stop) {
+        auto conn_id = (n++ % 16) + 1;
+        tracker.OnResult(conn_id, (n + r) % 7 != 0, 100 + n % 50);
+        tracker.IsAvailable(conn_id);
+      }
+    });
+  }
+  
+  for (int round = 0; round < 1000; ++round) {
+    for (uint64_t conn_id = 1; conn_id <= 16; ++conn_id) {
+      tracker.OnConnected(conn_id);
+    }
+    for (uint64_t conn_id = 1; conn_id <= 16; conn_id += 2) {
+      tracker.OnClosed(conn_id);
+    }
+  }
+  stop = true;
+  for (auto& t : reporters) {
+    t.join();
+  }
+  
+  std::vector<BackendHealthStats> stats;
+  tracker.GetStats(&stats);
+  assert(stats.size() == 8);
+  
+  std::cout << "TestConcurrentResult> ok" << std::endl;
+}
+
+void TestOptionToString() {
+  BackendHealthOption option;
+  option.min_requests = 33;
+  option.interval_ms = 4567;
+  auto s = option.ToString();
+  assert(s.find("min_requests: 33") != std::string::npos);
+  assert(s.find("interval_ms: 4567") != std::string::npos);
+  
+  std::cout << "TestOptionToString> ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  TestConsecutiveErrors();
+  TestConcurrentResult();
+  TestOptionToString();
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// ConnFlowControlHandler写缓冲水位:
+//  1. CLOSE: 超出高水位的写不往下传, 关闭连接, 返回的future失败, 之后的写都失败
+//  2. PAUSE_READ: 数据照常写出, 不丢弃
+
+// 测试里assert始终生效
+#undef NDEBUG
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "nebula/net/base/nebula_pipeline.h"
+#include "nebula/net/handler/conn_flow_control_handler.h"
+
+using namespace nebula;
+
+// 代替socket: 写完成由测试控制
+class CaptureHandler : public wangle::OutboundBytesToBytesHandler {
+public:
+  folly::Future<folly::Unit> write(Context* ctx, std::unique_ptr<folly::IOBuf> buf) override {
+    bytes.push_back(buf->computeChainDataLength());
+    promises.emplace_back();
+    return promises.back().getFuture();
+  }
+  
+  folly::Future<folly::Unit> close(Context* ctx) override {
+    ++closes;
+    return folly::makeFuture();
+  }
+  
+  std::vector<size_t> bytes;
+  std::vector<folly::Promise<folly::Unit>> promises;
+  int closes {0};
+};
+
+std::unique_ptr<folly::IOBuf> MakeData(size_t len) {
+  auto buf = folly::IOBuf::create(len);
+  buf->append(len);
+  return buf;
+}
+
+DefaultPipeline::Ptr MakePipeline(CaptureHandler* capture, WriteOverflowPolicy policy) {
+  ServiceConfig config;
+  config.name = "test";
+  config.write_high_watermark = 100;
+  config.write_low_watermark = 50;
+  config.write_overflow_policy = policy;
+  
+  auto pipeline = DefaultPipeline::create();
+  pipeline->addBack(capture);
+  pipeline->addBack(ConnFlowControlHandler(config));
+  pipeline->finalize();
+  return pipeline;
+}
+
+void TestClose() {
+  CaptureHandler capture;
+  auto pipeline = MakePipeline(&capture, WriteOverflowPolicy::CLOSE);
+  
+  auto f1 = pipeline->write(MakeData(60));
+  assert(capture.bytes.size() == 1);
+  assert(!f1.isReady());
+  
+  // 超出高水位: 不写出, 关闭连接, 写失败
+  auto f2 = pipeline->write(MakeData(60));
+  assert(capture.bytes.size() == 1);
+  assert(capture.closes == 1);
+  assert(f2.isReady() && f2.hasException());
+  
+  // 之后的写都失败, 不会再关闭一次
+  auto f3 = pipeline->write(MakeData(10));
+  assert(f3.isReady() && f3.hasException());
+  assert(capture.closes == 1);
+  
+  // 已经写出的完成后也不恢复
+  capture.promises[0].setValue();
+  assert(f1.isReady() && !f1.hasException());
+  auto f4 = pipeline->write(MakeData(10));
+  assert(f4.isReady() && f4.hasException());
+  assert(capture.bytes.size() == 1);
+  
+  std::cout << "TestClose> ok" << std::endl;
+}
+
+void TestPauseRead() {
+  CaptureHandler capture;
+  auto pipeline = MakePipeline(&capture, WriteOverflowPolicy::PAUSE_READ);
+  
+  // 超过高水位只暂停读, 数据都写出
+  std::vector<folly::Future<folly::Unit>> futures;
+  for (int i = 0; i < 4; ++i) {
+    futures.push_back(pipeline->write(MakeData(60)));
+  }
+  assert(capture.bytes.size() == 4);
+  assert(capture.closes == 0);
+  for (size_t i = 0; i < futures.size(); ++i) {
+    assert(!futures[i].isReady());
+    capture.promises[i].setValue();
+    assert(futures[i].isReady() && !futures[i].hasException());
+  }
+  
+  std::cout << "TestPauseRead> ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  TestClose();
+  TestPauseRead();
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// ConnIndex:
+//  1. 同一个key可以绑多个连接, Unbind后查不到
+//  2. 删掉的槽可以复用, 装满后挂新表, 查找能跨表
+//  3. 写线程不停地绑定/解绑时, 读线程只会查到绑过的conn_id
+
+// 测试里assert始终生效
+#undef NDEBUG
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "nebula/net/conn_index.h"
+
+using namespace nebula;
+
+void TestBindUnbind() {
+  auto& conn_index = ConnIndex::GetInstance();
+  std::vector<uint64_t> conn_ids;
+  
+  conn_index.Bind(1, 1001, 2001);
+  conn_index.Bind(2, 1001, 2002);
+  conn_index.Bind(2, 1001, 2002);
+  
+  assert(conn_index.LookupByAuthID(1001, &conn_ids) == 2);
+  std::sort(conn_ids.begin(), conn_ids.end());
+  assert(conn_ids == std::vector<uint64_t>({1, 2}));
+  
+  conn_ids.clear();
+  assert(conn_index.LookupBySessionID(2002, &conn_ids) == 1);
+  assert(conn_ids[0] == 2);
+  
+  conn_index.Unbind(1, 1001, 2001);
+  conn_ids.clear();
+  assert(conn_index.LookupByAuthID(1001, &conn_ids) == 1);
+  assert(conn_ids[0] == 2);
+  assert(conn_index.LookupBySessionID(2001, &conn_ids) == 0);
+  
+  conn_index.Unbind(2, 1001, 2002);
+  assert(conn_index.LookupByAuthID(1001, &conn_ids) == 0);
+  assert(conn_index.LookupByAuthID(0, &conn_ids) == 0);
+  
+  std::cout << "TestBindUnbind> ok" << std::endl;
+}
+
+void TestGrow() {
+  auto& conn_index = ConnIndex::GetInstance();
+  std::vector<uint64_t> conn_ids;
+  
+  // 同一个key绑大量连接, 第一张表装不下
+  const int kConnCount = 1000;
+  for (int i = 1; i <= kConnCount; ++i) {
+    conn_index.Bind(i, 3001, 0);
+  }
+  assert(conn_index.LookupByAuthID(3001, &conn_ids) == kConnCount);
+  
+  for (int i = 1; i <= kConnCount; i += 2) {
+    conn_index.Unbind(i, 3001, 0);
+  }
+  conn_ids.clear();
+  assert(conn_index.LookupByAuthID(3001, &conn_ids) == kConnCount / 2);
+  for (auto conn_id : conn_ids) {
+    assert(conn_id % 2 == 0);
+  }
+  
+  // 删掉的槽被复用
+  for (int i = 1; i <= kConnCount; i += 2) {
+    conn_index.Bind(i, 3002, 0);
+  }
+  conn_ids.clear();
+  assert(conn_index.LookupByAuthID(3002, &conn_ids) == kConnCount / 2);
+  for (auto conn_id : conn_ids) {
+    assert(conn_id % 2 == 1);
+  }
+  
+  std::cout << "TestGrow> ok" << std::endl;
+}
+
+void TestConcurrentLookup() {
+  auto& conn_index = ConnIndex::GetInstance();
+  std::atomic<bool> stop {false};
+  
+  // auth_id 4001..4008轮流绑定conn_id 100..199
+  std::thread writer([&]() {
+    for (int round = 0; round < 200; ++round) {
+      for (int i = 100; i < 200; ++i) {
+        conn_index.Bind(i, 4001 + i % 8, 0);
+      }
+      for (int i = 100; i < 200; ++i) {
+        conn_index.Unbind(i, 4001 + i % 8, 0);
+      }
+    }
+    stop = true;
+  });
+  
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&]() {
+      std::vector<uint64_t> conn_ids;
+      while (!stop) {
+        for (int64_t auth_id = 4001; auth_id <= 4008; ++auth_id) {
+          conn_ids.clear();
+          conn_index.LookupByAuthID(auth_id, &conn_ids);
+          for (auto conn_id : conn_ids) {
+            assert(conn_id >= 100 && conn_id < 200);
+            assert(4001 + static_cast<int64_t>(conn_id % 8) == auth_id);
+          }
+        }
+      }
+    });
+  }
+  
+  writer.join();
+  for (auto& t : readers) {
+    t.join();
+  }
+  
+  std::vector<uint64_t> conn_ids;
+  for (int64_t auth_id = 4001; auth_id <= 4008; ++auth_id) {
+    assert(conn_index.LookupByAuthID(auth_id, &conn_ids) == 0);
+  }
+  
+  std::cout << "TestConcurrentLookup> ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  TestBindUnbind();
+  TestGrow();
+  TestConcurrentLookup();
+  return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// ConnWriteMailbox的投递顺序:
+//  1. 多个线程同时Post, 同一线程投递到同一连接的消息按投递顺序写出
+//  2. 每条消息单独写一次, 不合并
+//  3. 已关闭的连接丢弃
+
+// 测试里assert始终生效
+#undef NDEBUG
+
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <folly/io/async/EventBase.h>
+#include <wangle/channel/Handler.h>
+
+#include "nebula/net/base/nebula_pipeline.h"
+#include "nebula/net/conn_write_mailbox.h"
+#include "nebula/net/thread_local_conn_manager.h"
+
+using namespace nebula;
+
+// 截获写到连接上的数据, 每次write记一条
+class CaptureHandler : public wangle::OutboundHandler<std::unique_ptr<folly::IOBuf>> {
+public:
+  folly::Future<folly::Unit> write(Context* ctx, std::unique_ptr<folly::IOBuf> buf) override {
+    writes.push_back(buf->moveToFbString().toStdString());
+    return folly::makeFuture();
+  }
+  
+  std::vector<std::string> writes;
+};
+
+struct TestConn {
+  CaptureHandler capture;
+  DefaultPipeline::Ptr pipeline;
+  uint64_t conn_id {0};
+};
+
+// 消息内容: "producer:seq"
+std::string MakeMessage(int producer, int seq) {
+  return std::to_string(producer) + ":" + std::to_string(seq);
+}
+
+void ParseMessage(const std::string& msg, int* producer, int* seq) {
+  auto pos = msg.find(':');
+  assert(pos != std::string::npos);
+  *producer = std::stoi(msg.substr(0, pos));
+  *seq = std::stoi(msg.substr(pos + 1));
+}
+
+void TestPostOrder() {
+  const int kConnCount = 3;
+  const int kProducerCount = 4;
+  const int kMessageCount = 20000;    // 每个生产者
+  
+  // 本线程就是IO线程, Drain在evb.loopOnce()里执行
+  folly::EventBase evb;
+  auto& conn_manager = GetConnManagerByThreadLocal();
+  
+  std::vector<std::unique_ptr<TestConn>> conns;
+  for (int i = 0; i < kConnCount; ++i) {
+    conns.emplace_back(new TestConn());
+    auto& conn = *conns.back();
+    conn.pipeline = DefaultPipeline::create();
+    conn.pipeline->addBack(&conn.capture);
+    conn.pipeline->finalize();
+    conn.conn_id = conn_manager.OnNewConnection(conn.pipeline.get());
+    assert(conn.conn_id != 0);
+  }
+  
+  ConnWriteMailbox mailbox(&evb);
+  
+  // 每个生产者按顺序轮流投递到各个连接
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducerCount; ++p) {
+    producers.emplace_back([&, p]() {
+      for (int seq = 0; seq < kMessageCount; ++seq) {
+        auto& conn = *conns[seq % kConnCount];
+        mailbox.Post(conn.conn_id, folly::IOBuf::copyBuffer(MakeMessage(p, seq)));
+      }
+    });
+  }
+  
+  auto received = [&conns]() {
+    size_t n = 0;
+    for (auto& conn : conns) {
+      n += conn->capture.writes.size();
+    }
+    return n;
+  };
+  
+  const size_t total = kProducerCount * kMessageCount;
+  while (received() < total) {
+    evb.loopOnce();
+  }
+  for (auto& v : producers) {
+    v.join();
+  }
+  // 不会多写
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  assert(received() == total);
+  
+  for (int i = 0; i < kConnCount; ++i) {
+    // 每个生产者在这个连接上的seq: i, i + kConnCount, ...
+    std::map<int, int> next_seq;
+    for (auto& msg : conns[i]->capture.writes) {
+      int producer = 0, seq = 0;
+      ParseMessage(msg, &producer, &seq);
+      assert(producer >= 0 && producer < kProducerCount);
+      if (next_seq.find(producer) == next_seq.end()) {
+        next_seq[producer] = i;
+      }
+      assert(seq == next_seq[producer]);
+      next_seq[producer] += kConnCount;
+    }
+    assert(static_cast<int>(next_seq.size()) == kProducerCount);
+  }
+  
+  // 已关闭的连接丢弃, 其它连接不受影响
+  assert(conn_manager.OnConnectionClosed(conns[0]->conn_id));
+  conns[0]->capture.writes.clear();
+  conns[1]->capture.writes.clear();
+  mailbox.Post(conns[0]->conn_id, folly::IOBuf::copyBuffer(MakeMessage(0, 0)));
+  mailbox.Post(conns[1]->conn_id, folly::IOBuf::copyBuffer(MakeMessage(0, 1)));
+  while (conns[1]->capture.writes.empty()) {
+    evb.loopOnce();
+  }
+  assert(conns[0]->capture.writes.empty());
+  assert(conns[1]->capture.writes.size() == 1);
+  assert(conns[1]->capture.writes[0] == MakeMessage(0, 1));
+  
+  for (int i = 1; i < kConnCount; ++i) {
+    assert(conn_manager.OnConnectionClosed(conns[i]->conn_id));
+  }
+  
+  std::cout << "TestPostOrder> ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  TestPostOrder();
+  return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// ListenSocketHandoff:
+//  新进程取回监听fd后一直不确认, 旧进程Stop()要马上返回, 不等kTakeoverAckTimeout
+
+// 测试里assert始终生效
+#undef NDEBUG
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "nebula/net/base/socket_handoff.h"
+
+using namespace nebula;
+
+void TestStopWhileWaitingAck() {
+  auto& handoff = ListenSocketHandoff::GetInstance();
+  std::string path = "/tmp/socket_handoff_test." + std::to_string(getpid());
+  
+  int fds[2];
+  assert(pipe(fds) == 0);
+  
+  std::atomic<bool> handed_off {false};
+  assert(handoff.Listen(path,
+                        [&]() { return ListenFdList{{"test_server", fds[0]}}; },
+                        [&]() { handed_off = true; }));
+  
+  // 取回fd, 但不调用CompleteTakeover
+  assert(handoff.Takeover(path));
+  auto inherited = handoff.TakeInheritedFds("test_server");
+  assert(inherited.size() == 1);
+  
+  auto start = std::chrono::steady_clock::now();
+  handoff.Stop();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  assert(elapsed < std::chrono::seconds(5));
+  assert(!handed_off);
+  assert(access(path.c_str(), F_OK) != 0);
+  
+  close(inherited[0]);
+  close(fds[0]);
+  close(fds[1]);
+  
+  std::cout << "TestStopWhileWaitingAck> ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  TestStopWhileWaitingAck();
+  return 0;
+}
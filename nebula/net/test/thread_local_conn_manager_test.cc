@@ -0,0 +1,180 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// ThreadLocalConnManager的slot表:
+//  1. 关闭连接时和最后一个存活连接交换后删除
+//  2. 空闲slot先进先出复用
+//  3. slot复用后generation加1, 旧的conn_id查不到新连接, generation回绕时跳过0
+
+// 测试里assert始终生效
+#undef NDEBUG
+
+#include <cassert>
+#include <iostream>
+#include <map>
+
+#include "nebula/net/thread_local_conn_manager.h"
+
+using namespace nebula;
+
+// 打开protected的常量
+class TestConnManager : public ThreadLocalConnManager {
+public:
+  using ThreadLocalConnManager::kSlotIndexBits;
+  using ThreadLocalConnManager::kSlotIndexMask;
+  using ThreadLocalConnManager::kGenerationMask;
+};
+
+// slot表只保存pipeline指针, 不访问, 用假指针即可
+wangle::PipelineBase* FakePipeline(int i) {
+  return reinterpret_cast<wangle::PipelineBase*>(static_cast<uintptr_t>(i + 1) * 64);
+}
+
+uint32_t SlotIndex(uint64_t conn_id) {
+  return static_cast<uint32_t>(conn_id) & TestConnManager::kSlotIndexMask;
+}
+
+uint32_t Generation(uint64_t conn_id) {
+  return static_cast<uint32_t>(conn_id) >> TestConnManager::kSlotIndexBits;
+}
+
+std::map<uint64_t, wangle::PipelineBase*> GetAll(TestConnManager& conns) {
+  std::map<uint64_t, wangle::PipelineBase*> all;
+  conns.ForEachPipeline([&all](uint64_t conn_id, wangle::PipelineBase* pipeline) {
+    all[conn_id] = pipeline;
+  });
+  return all;
+}
+
+void TestSwapRemove() {
+  TestConnManager conns;
+  conns.set_thread_id(3);
+  
+  uint64_t ids[4];
+  for (int i = 0; i < 4; ++i) {
+    ids[i] = conns.OnNewConnection(FakePipeline(i));
+    assert(ids[i] >> 32 == 3);
+    assert(SlotIndex(ids[i]) == static_cast<uint32_t>(i));
+    assert(Generation(ids[i]) == 1);
+  }
+  assert(conns.GetConnCount() == 4);
+  
+  // 删除中间的, 最后一个被换到它的位置, 仍然能查到
+  assert(conns.OnConnectionClosed(ids[1]));
+  assert(conns.GetConnCount() == 3);
+  assert(conns.FindPipeline(ids[1]) == nullptr);
+  assert(conns.FindPipeline(ids[0]) == FakePipeline(0));
+  assert(conns.FindPipeline(ids[2]) == FakePipeline(2));
+  assert(conns.FindPipeline(ids[3]) == FakePipeline(3));
+  
+  auto all = GetAll(conns);
+  assert(all.size() == 3);
+  assert(all[ids[0]] == FakePipeline(0));
+  assert(all[ids[2]] == FakePipeline(2));
+  assert(all[ids[3]] == FakePipeline(3));
+  
+  // 删除最后一个, 不需要交换
+  assert(conns.OnConnectionClosed(ids[2]));
+  assert(conns.FindPipeline(ids[3]) == FakePipeline(3));
+  assert(conns.GetConnCount() == 2);
+  
+  // 重复关闭、别的线程的conn_id
+  assert(!conns.OnConnectionClosed(ids[1]));
+  assert(conns.FindPipeline(ids[0] & 0xffffffff) == nullptr);
+  assert(!conns.OnConnectionClosed(ids[0] & 0xffffffff));
+  assert(conns.GetConnCount() == 2);
+  
+  assert(conns.OnConnectionClosed(ids[0]));
+  assert(conns.OnConnectionClosed(ids[3]));
+  assert(conns.GetConnCount() == 0);
+  assert(GetAll(conns).empty());
+  
+  std::cout << "TestSwapRemove> ok" << std::endl;
+}
+
+void TestFifoFreeList() {
+  TestConnManager conns;
+  
+  uint64_t ids[4];
+  for (int i = 0; i < 4; ++i) {
+    ids[i] = conns.OnNewConnection(FakePipeline(i));
+  }
+  
+  // 按关闭顺序复用: 2, 0, 3
+  assert(conns.OnConnectionClosed(ids[2]));
+  assert(conns.OnConnectionClosed(ids[0]));
+  assert(conns.OnConnectionClosed(ids[3]));
+  
+  auto a = conns.OnNewConnection(FakePipeline(10));
+  auto b = conns.OnNewConnection(FakePipeline(11));
+  auto c = conns.OnNewConnection(FakePipeline(12));
+  assert(SlotIndex(a) == 2 && Generation(a) == 2);
+  assert(SlotIndex(b) == 0 && Generation(b) == 2);
+  assert(SlotIndex(c) == 3 && Generation(c) == 2);
+  
+  // 空闲链表用完后再新建slot
+  auto d = conns.OnNewConnection(FakePipeline(13));
+  assert(SlotIndex(d) == 4 && Generation(d) == 1);
+  
+  // 旧的conn_id查不到复用了同一个slot的新连接, 也关不掉它
+  assert(conns.FindPipeline(ids[2]) == nullptr);
+  assert(!conns.OnConnectionClosed(ids[2]));
+  assert(conns.FindPipeline(a) == FakePipeline(10));
+  assert(conns.FindPipeline(b) == FakePipeline(11));
+  assert(conns.FindPipeline(c) == FakePipeline(12));
+  assert(conns.FindPipeline(d) == FakePipeline(13));
+  assert(conns.FindPipeline(ids[1]) == FakePipeline(1));
+  assert(conns.GetConnCount() == 5);
+  
+  std::cout << "TestFifoFreeList> ok" << std::endl;
+}
+
+void TestGenerationWrap() {
+  TestConnManager conns;
+  
+  // 同一个slot反复复用, generation回绕时跳过0, 低32位始终不为0
+  uint64_t last = conns.OnNewConnection(FakePipeline(0));
+  uint32_t rounds = TestConnManager::kGenerationMask + 10;
+  bool wrapped = false;
+  for (uint32_t i = 0; i < rounds; ++i) {
+    assert(conns.OnConnectionClosed(last));
+    auto conn_id = conns.OnNewConnection(FakePipeline(0));
+    assert(SlotIndex(conn_id) == 0);
+    assert(static_cast<uint32_t>(conn_id) != 0);
+    assert(Generation(conn_id) != 0);
+    if (Generation(conn_id) < Generation(last)) {
+      assert(Generation(last) == TestConnManager::kGenerationMask);
+      assert(Generation(conn_id) == 1);
+      wrapped = true;
+    } else {
+      assert(Generation(conn_id) == Generation(last) + 1);
+    }
+    assert(conns.FindPipeline(last) == nullptr);
+    last = conn_id;
+  }
+  assert(wrapped);
+  assert(conns.GetConnCount() == 1);
+  
+  std::cout << "TestGenerationWrap> ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  TestSwapRemove();
+  TestFifoFreeList();
+  TestGenerationWrap();
+  return 0;
+}
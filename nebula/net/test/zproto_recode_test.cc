@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// RecodePackageMessage: 本地调用时请求和应答按网络格式编解码一次
+//  服务端拿到EncodedRpcRequest, 客户端拿到EncodedRpcOk等, 字段和payload不变
+
+// 测试里assert始终生效
+#undef NDEBUG
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#include "nebula/net/zproto/zproto_package_data.h"
+
+std::unique_ptr<folly::IOBuf> MakePayload(const std::string& s) {
+  return folly::IOBuf::copyBuffer(s);
+}
+
+std::string GetPayload(const EncodedMessage& message) {
+  assert(message.payload);
+  auto buf = message.payload->clone();
+  return buf->moveToFbString().toStdString();
+}
+
+void TestRecodeRequest() {
+  EncodedRpcRequest request;
+  request.package_header.auth_id = 7;
+  request.set_message_id(1001);
+  request.method_id = 42;
+  auto payload = MakePayload("hello");
+  request.message.SwapPayload(payload);
+  
+  auto r = std::dynamic_pointer_cast<EncodedRpcRequest>(RecodePackageMessage(request));
+  assert(r);
+  assert(r.get() != &request);
+  assert(r->auth_id() == 7);
+  assert(r->message_id() == 1001);
+  assert(r->method_id == 42);
+  assert(GetPayload(r->message) == "hello");
+  
+  // 原请求不变
+  assert(GetPayload(request.message) == "hello");
+  
+  std::cout << "TestRecodeRequest> ok" << std::endl;
+}
+
+void TestRecodeResponse() {
+  EncodedRpcOk ok;
+  ok.req_message_id = 1001;
+  ok.method_response_id = 43;
+  auto payload = MakePayload("world");
+  ok.message.SwapPayload(payload);
+  
+  auto r = std::dynamic_pointer_cast<EncodedRpcOk>(RecodePackageMessage(ok));
+  assert(r);
+  assert(r->req_message_id == 1001);
+  assert(r->method_response_id == 43);
+  assert(GetPayload(r->message) == "world");
+  
+  RpcFloodWait flood_wait(1002, 3);
+  auto r2 = std::dynamic_pointer_cast<RpcFloodWait>(RecodePackageMessage(flood_wait));
+  assert(r2);
+  assert(r2->req_message_id == 1002);
+  assert(r2->delay == 3);
+  
+  std::cout << "TestRecodeResponse> ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  TestRecodeRequest();
+  TestRecodeResponse();
+  return 0;
+}
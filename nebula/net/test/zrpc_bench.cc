@@ -0,0 +1,276 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// zrpc压测工具
+//
+// 用法:
+//  zrpc_bench -config=zrpc_bench.json -role=both -concurrency=64 -duration=30
+//  zrpc_bench -config=zrpc_bench.json -role=client -rps=50000 -duration=30
+//
+// 配置文件里需要配置:
+//  服务端: name为zrpc_bench_server, type为rpc_server, proto为zrpc
+//  客户端: name为zrpc_bench, type为rpc_client, proto为zrpc, 每个后端配一项, 同名的自动组成tcp_client_group
+//  role为both时客户端不要配置local_call为true, 否则调用不经过网络
+//  示例见同目录下的zrpc_bench.json(单机both模式, 多个后端时客户端按后端加项)
+//
+// 两种模式:
+//  1. 闭环(rps为0): concurrency个调用并发, 每个调用完成后立即发起下一个, 测最大吞吐
+//  2. 开环(rps大于0): 按固定速率发送, 延时从计划发送时间算起,
+//     后端变慢时排队的等待时间也计入延时, 避免coordinated omission
+
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include <folly/Format.h>
+#include <folly/futures/Future.h>
+
+#include "nebula/net/base_server.h"
+#include "nebula/net/net_engine_manager.h"
+#include "nebula/net/engine/tcp_client_group.h"
+#include "nebula/net/rpc/zrpc_latency_stats.h"
+#include "nebula/net/rpc/zrpc_service_util.h"
+
+DEFINE_string(role, "both", "both/server/client");
+DEFINE_int32(concurrency, 64, "closed-loop concurrent calls");
+DEFINE_int32(rps, 0, "open-loop requests per second, 0 for closed-loop");
+DEFINE_int32(duration, 30, "measure seconds");
+DEFINE_int32(warmup, 3, "warmup seconds, not measured");
+DEFINE_int32(payload_size, 64, "request payload bytes, echoed back");
+DEFINE_int32(sleep_us, 0, "server handler busy time per call");
+DEFINE_string(server_exec, "inline", "server handler executor: inline/cpu");
+
+namespace {
+
+const int kBenchEchoMethodID = 0x7FFF0001;
+const char* kBenchServiceName = "zrpc_bench";
+
+uint64_t NowInUsec() {
+  return ZRpcLatencyStats::NowInUsec();
+}
+
+ProtoRpcResponsePtr OnBenchEcho(RpcRequestPtr request) {
+  if (FLAGS_sleep_us > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(FLAGS_sleep_us));
+  }
+  
+  auto encoded = std::static_pointer_cast<EncodedRpcRequest>(request);
+  auto rsp = std::make_shared<EncodedRpcOk>();
+  rsp->req_message_id = request->message_id();
+  rsp->method_response_id = kBenchEchoMethodID;
+  if (encoded->message.payload) {
+    auto payload = encoded->message.payload->clone();
+    rsp->message.SwapPayload(payload);
+  }
+  return rsp;
+}
+
+class BenchDriver {
+public:
+  BenchDriver() {
+    auto payload = folly::IOBuf::create(FLAGS_payload_size);
+    memset(payload->writableData(), 'z', FLAGS_payload_size);
+    payload->append(FLAGS_payload_size);
+    payload_ = std::move(payload);
+  }
+  
+  void Run() {
+    if (!WaitConnected()) {
+      std::cout << "zrpc_bench - no online connection to " << kBenchServiceName << std::endl;
+      return;
+    }
+    
+    auto start = NowInUsec();
+    measure_start_ = start + FLAGS_warmup * 1000000ULL;
+    stop_time_ = measure_start_ + FLAGS_duration * 1000000ULL;
+    
+    if (FLAGS_rps > 0) {
+      RunOpenLoop(start);
+    } else {
+      for (int i = 0; i < FLAGS_concurrency; ++i) {
+        running_.fetch_add(1);
+        IssueClosedLoop();
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(stop_time_ - start));
+    }
+    
+    // 等待未完成的调用, 最多5秒
+    auto deadline = NowInUsec() + 5000000;
+    while (running_.load() > 0 && NowInUsec() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    
+    Report();
+  }
+  
+private:
+  bool WaitConnected() {
+    for (int i = 0; i < 100; ++i) {
+      auto service = nebula::NetEngineManager::GetInstance()->Lookup(kBenchServiceName);
+      nebula::TcpClientGroupBase::OnlineTcpClientList clients;
+      if (service &&
+          std::static_pointer_cast<nebula::TcpClientGroupBase>(service)->GetOnlineClients(&clients)) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return false;
+  }
+  
+  RpcRequestPtr MakeRequest() {
+    auto request = std::make_shared<EncodedRpcRequest>();
+    request->method_id = kBenchEchoMethodID;
+    auto payload = payload_->clone();
+    request->message.SwapPayload(payload);
+    return request;
+  }
+  
+  // intended_time: 计划发送时间, 延时从这里算起
+  void OnComplete(uint64_t intended_time, const ProtoRpcResponsePtr& rsp) {
+    auto now = NowInUsec();
+    if (intended_time < measure_start_ || intended_time >= stop_time_) {
+      return;
+    }
+    if (!rsp || rsp->GetPackageType() != Package::RPC_OK) {
+      errors_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    histogram_.Add(now - intended_time);
+  }
+  
+  void IssueClosedLoop() {
+    auto start = NowInUsec();
+    if (start >= stop_time_) {
+      running_.fetch_sub(1);
+      return;
+    }
+    
+    ZRpcUtil::DoClientCall(kBenchServiceName, MakeRequest()).then([this, start](ProtoRpcResponsePtr rsp) {
+      OnComplete(start, rsp);
+      IssueClosedLoop();
+    }).onError([this](const std::exception& e) {
+      errors_.fetch_add(1, std::memory_order_relaxed);
+      running_.fetch_sub(1);
+    });
+  }
+  
+  void RunOpenLoop(uint64_t start) {
+    double interval_us = 1000000.0 / FLAGS_rps;
+    for (uint64_t i = 0; ; ++i) {
+      auto intended_time = start + static_cast<uint64_t>(i * interval_us);
+      if (intended_time >= stop_time_) {
+        break;
+      }
+      
+      auto now = NowInUsec();
+      if (intended_time > now) {
+        std::this_thread::sleep_for(std::chrono::microseconds(intended_time - now));
+      }
+      
+      running_.fetch_add(1);
+      ZRpcUtil::DoClientCall(kBenchServiceName, MakeRequest()).then([this, intended_time](ProtoRpcResponsePtr rsp) {
+        OnComplete(intended_time, rsp);
+        running_.fetch_sub(1);
+      }).onError([this](const std::exception& e) {
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        running_.fetch_sub(1);
+      });
+    }
+  }
+  
+  void Report() {
+    ZRpcLatencyHistogram::Snapshot snapshot;
+    histogram_.GetSnapshot(&snapshot);
+    
+    std::cout << folly::sformat("zrpc_bench - mode: {}, payload: {}B, duration: {}s",
+                                FLAGS_rps > 0 ? folly::sformat("open-loop {} rps", FLAGS_rps) :
+                                    folly::sformat("closed-loop concurrency {}", FLAGS_concurrency),
+                                FLAGS_payload_size,
+                                FLAGS_duration) << std::endl;
+    std::cout << folly::sformat("  calls: {}, errors: {}, throughput: {:.1f} rps",
+                                snapshot.count,
+                                errors_.load(),
+                                static_cast<double>(snapshot.count) / std::max(FLAGS_duration, 1)) << std::endl;
+    std::cout << folly::sformat("  latency(us) avg: {}, p50: {}, p99: {}, p999: {}, max: {}",
+                                snapshot.count ? snapshot.sum / snapshot.count : 0,
+                                snapshot.GetPercentile(50),
+                                snapshot.GetPercentile(99),
+                                snapshot.GetPercentile(99.9),
+                                snapshot.max) << std::endl;
+  }
+  
+  std::unique_ptr<folly::IOBuf> payload_;
+  uint64_t measure_start_ {0};
+  uint64_t stop_time_ {0};
+  std::atomic<int> running_ {0};
+  std::atomic<uint64_t> errors_ {0};
+  ZRpcLatencyHistogram histogram_;
+};
+
+}
+
+class ZRpcBench : public nebula::BaseServer {
+public:
+  ZRpcBench() = default;
+  ~ZRpcBench() override = default;
+  
+protected:
+  bool Initialize() override {
+    if (FLAGS_role != "client") {
+      ZRpcMethodOption option;
+      if (FLAGS_server_exec == "cpu") {
+        option.exec_type = ZRpcExecType::CPU;
+      }
+      ZRpcUtil::Register(kBenchEchoMethodID, OnBenchEcho, option);
+      RegisterService("zrpc_bench_server", "rpc_server", "zrpc");
+    }
+    if (FLAGS_role != "server") {
+      RegisterService(kBenchServiceName, "rpc_client", "zrpc");
+    }
+    
+    BaseServer::Initialize();
+    return true;
+  }
+  
+  bool Run() override {
+    if (FLAGS_role != "server") {
+      // 压测结束后退出
+      driver_thread_ = std::thread([this]() {
+        BenchDriver driver;
+        driver.Run();
+        main_eb_.terminateLoopSoon();
+      });
+    }
+    
+    BaseServer::Run();
+    
+    if (driver_thread_.joinable()) {
+      driver_thread_.join();
+    }
+    return true;
+  }
+  
+private:
+  std::thread driver_thread_;
+};
+
+int main(int argc, char* argv[]) {
+  return nebula::DoMain<ZRpcBench>(argc, argv);
+}
@@ -0,0 +1,213 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// ZRpcMultiplexClientDispatcher的未完成请求表:
+//  1. 连接内的请求id只写在发送副本上, 应答换回调用方的message_id
+//  2. 槽位完成后复用, 被慢请求占用的槽位跳过
+//  3. 槽位都被占用时扩容, 扩容后已有的请求仍能完成
+//  4. 连接断开时所有未完成的请求应答RpcInternalError
+
+// 测试里assert始终生效
+#undef NDEBUG
+
+#include <cassert>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "nebula/net/rpc/zrpc_client_dispatcher.h"
+
+// 见ZRpcMultiplexClientDispatcher::kInitialPendingSlots
+const int kInitialPendingSlots = 1024;
+
+// 截获dispatcher写出的请求, 不再往下写
+class CaptureHandler : public wangle::Handler<folly::IOBufQueue&, ProtoRpcResponsePtr,
+                                              RpcRequestPtr, RpcRequestPtr> {
+public:
+  void read(Context* ctx, folly::IOBufQueue& q) override {
+  }
+  
+  folly::Future<folly::Unit> write(Context* ctx, RpcRequestPtr req) override {
+    sent.push_back(req);
+    return folly::makeFuture();
+  }
+  
+  std::vector<RpcRequestPtr> sent;
+};
+
+RpcRequestPtr MakeRequest(int64_t message_id) {
+  auto r = std::make_shared<EncodedRpcRequest>();
+  r->set_message_id(message_id);
+  r->method_id = 1;
+  return r;
+}
+
+// 对端按连接内的id应答
+void Reply(ZRpcMultiplexClientDispatcher* dispatcher, const RpcRequestPtr& sent) {
+  dispatcher->read(nullptr, std::make_shared<RpcInternalError>(sent->message_id()));
+}
+
+int64_t GetReqMessageID(folly::Future<ProtoRpcResponsePtr>& f) {
+  assert(f.isReady());
+  return f.value()->req_message_id;
+}
+
+void TestSendCopy() {
+  CaptureHandler capture;
+  auto pipeline = ZRpcClientPipeline::create();
+  pipeline->addBack(&capture);
+  auto dispatcher = std::make_shared<ZRpcMultiplexClientDispatcher>("test");
+  dispatcher->setPipeline(pipeline.get());
+  
+  auto request = MakeRequest(1000);
+  auto f = (*dispatcher)(request);
+  
+  // 调用方的请求不变, 发出去的是副本
+  assert(capture.sent.size() == 1);
+  assert(capture.sent[0] != request);
+  assert(request->message_id() == 1000);
+  assert(capture.sent[0]->message_id() == 1);
+  assert(!f.isReady());
+  
+  // 同一个请求再发一次(对冲、扇出), 两次发送的id不同, 互不影响
+  auto f2 = (*dispatcher)(request);
+  assert(capture.sent.size() == 2);
+  assert(capture.sent[1]->message_id() == 2);
+  assert(request->message_id() == 1000);
+  
+  // 应答换回调用方的id
+  Reply(dispatcher.get(), capture.sent[1]);
+  assert(GetReqMessageID(f2) == 1000);
+  assert(!f.isReady());
+  Reply(dispatcher.get(), capture.sent[0]);
+  assert(GetReqMessageID(f) == 1000);
+  
+  // 重复的应答和未知id的应答忽略
+  Reply(dispatcher.get(), capture.sent[0]);
+  dispatcher->read(nullptr, std::make_shared<RpcInternalError>(12345));
+  
+  std::cout << "TestSendCopy> ok" << std::endl;
+}
+
+void TestSlotReuse() {
+  CaptureHandler capture;
+  auto pipeline = ZRpcClientPipeline::create();
+  pipeline->addBack(&capture);
+  auto dispatcher = std::make_shared<ZRpcMultiplexClientDispatcher>("test");
+  dispatcher->setPipeline(pipeline.get());
+  
+  // 第一个请求(id 1)一直不完成, 占住槽位1
+  auto slow = (*dispatcher)(MakeRequest(1));
+  
+  // 其它请求逐个完成, 槽位一直复用, 不扩容
+  for (int i = 2; i <= kInitialPendingSlots * 3; ++i) {
+    auto f = (*dispatcher)(MakeRequest(i));
+    auto& sent = capture.sent.back();
+    // 槽位1被慢请求占用, id为1025、2049的跳过
+    assert(sent->message_id() % kInitialPendingSlots != 1);
+    Reply(dispatcher.get(), sent);
+    assert(GetReqMessageID(f) == i);
+  }
+  
+  std::set<int64_t> ids;
+  for (auto& v : capture.sent) {
+    ids.insert(v->message_id());
+  }
+  assert(ids.size() == capture.sent.size());
+  assert(ids.count(kInitialPendingSlots + 1) == 0);
+  assert(ids.count(kInitialPendingSlots * 2 + 1) == 0);
+  
+  assert(!slow.isReady());
+  Reply(dispatcher.get(), capture.sent[0]);
+  assert(GetReqMessageID(slow) == 1);
+  
+  std::cout << "TestSlotReuse> ok" << std::endl;
+}
+
+void TestGrow() {
+  CaptureHandler capture;
+  auto pipeline = ZRpcClientPipeline::create();
+  pipeline->addBack(&capture);
+  auto dispatcher = std::make_shared<ZRpcMultiplexClientDispatcher>("test");
+  dispatcher->setPipeline(pipeline.get());
+  
+  // 先完成一部分, 让未完成的id不从1开始连续
+  for (int i = 0; i < 100; ++i) {
+    auto f = (*dispatcher)(MakeRequest(i + 1));
+    Reply(dispatcher.get(), capture.sent.back());
+  }
+  capture.sent.clear();
+  
+  // 未完成的请求超过初始槽数, 扩容两次
+  const int count = kInitialPendingSlots * 3;
+  std::vector<folly::Future<ProtoRpcResponsePtr>> futures;
+  for (int i = 0; i < count; ++i) {
+    futures.push_back((*dispatcher)(MakeRequest(10000 + i)));
+  }
+  assert(static_cast<int>(capture.sent.size()) == count);
+  for (int i = 0; i < count; ++i) {
+    assert(capture.sent[i]->message_id() == 101 + i);
+    assert(!futures[i].isReady());
+  }
+  
+  // 倒序完成, 每个都找得到
+  for (int i = count - 1; i >= 0; --i) {
+    Reply(dispatcher.get(), capture.sent[i]);
+    assert(GetReqMessageID(futures[i]) == 10000 + i);
+  }
+  
+  // 扩容以后槽位继续复用
+  auto f = (*dispatcher)(MakeRequest(20000));
+  Reply(dispatcher.get(), capture.sent.back());
+  assert(GetReqMessageID(f) == 20000);
+  
+  std::cout << "TestGrow> ok" << std::endl;
+}
+
+void TestClear() {
+  CaptureHandler capture;
+  auto pipeline = ZRpcClientPipeline::create();
+  pipeline->addBack(&capture);
+  auto dispatcher = std::make_shared<ZRpcMultiplexClientDispatcher>("test");
+  dispatcher->setPipeline(pipeline.get());
+  
+  std::vector<folly::Future<ProtoRpcResponsePtr>> futures;
+  for (int i = 0; i < 10; ++i) {
+    futures.push_back((*dispatcher)(MakeRequest(500 + i)));
+  }
+  
+  // 连接断开, 每个请求都应答RpcInternalError, req_message_id为调用方的id
+  dispatcher->Clear();
+  for (int i = 0; i < 10; ++i) {
+    assert(futures[i].isReady());
+    assert(futures[i].value()->GetPackageType() == Package::RPC_INTERNAL_ERROR);
+    assert(futures[i].value()->req_message_id == 500 + i);
+  }
+  
+  // 之后迟到的应答忽略
+  Reply(dispatcher.get(), capture.sent[0]);
+  
+  std::cout << "TestClear> ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  TestSendCopy();
+  TestSlotReuse();
+  TestGrow();
+  TestClear();
+  return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2016, https://github.com/zhatalk
+ *  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// ZRpcSingleFlight:
+//  1. 相同的并发请求只执行一次call
+//  2. 等待的调用方拿到的是应答副本, req_message_id是自己的, payload相同
+//  3. 应答返回后再来的请求重新执行call
+
+// 测试里assert始终生效
+#undef NDEBUG
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "nebula/net/rpc/zrpc_single_flight.h"
+
+RpcRequestPtr MakeRequest(int64_t message_id, const std::string& s) {
+  auto request = std::make_shared<EncodedRpcRequest>();
+  request->set_message_id(message_id);
+  request->method_id = 42;
+  auto payload = folly::IOBuf::copyBuffer(s);
+  request->message.SwapPayload(payload);
+  return request;
+}
+
+std::string GetPayload(const EncodedMessage& message) {
+  assert(message.payload);
+  auto buf = message.payload->clone();
+  return buf->moveToFbString().toStdString();
+}
+
+void TestFollowerCopy() {
+  auto& single_flight = ZRpcSingleFlight::GetInstance();
+  
+  int calls = 0;
+  folly::Promise<ProtoRpcResponsePtr> p;
+  auto call = [&]() {
+    ++calls;
+    return p.getFuture();
+  };
+  
+  std::vector<folly::Future<ProtoRpcResponsePtr>> futures;
+  for (int64_t message_id = 1001; message_id <= 1003; ++message_id) {
+    auto request = MakeRequest(message_id, "hello");
+    auto key = ZRpcRequestKey::Make("test_service", request, false);
+    futures.push_back(single_flight.Do(key, message_id, call));
+  }
+  assert(calls == 1);
+  
+  auto ok = std::make_shared<EncodedRpcOk>();
+  ok->req_message_id = 1001;
+  ok->method_response_id = 43;
+  auto payload = folly::IOBuf::copyBuffer("world");
+  ok->message.SwapPayload(payload);
+  p.setValue(ok);
+  
+  std::vector<ProtoRpcResponsePtr> rsps;
+  for (auto& f : futures) {
+    assert(f.isReady());
+    rsps.push_back(f.value());
+  }
+  
+  // 发起请求的调用方拿到原应答
+  assert(rsps[0] == ok);
+  for (size_t i = 1; i < rsps.size(); ++i) {
+    auto r = std::dynamic_pointer_cast<EncodedRpcOk>(rsps[i]);
+    assert(r);
+    assert(r != ok);
+    assert(r->req_message_id == static_cast<int64_t>(1001 + i));
+    assert(r->method_response_id == 43);
+    assert(GetPayload(r->message) == "world");
+  }
+  assert(ok->req_message_id == 1001);
+  
+  // 在途请求已结束, 重新执行
+  auto request = MakeRequest(1004, "hello");
+  auto key = ZRpcRequestKey::Make("test_service", request, false);
+  single_flight.Do(key, 1004, [&]() {
+    ++calls;
+    return folly::makeFuture<ProtoRpcResponsePtr>(std::make_shared<RpcFloodWait>(1004, 1));
+  });
+  assert(calls == 2);
+  
+  std::cout << "TestFollowerCopy> ok" << std::endl;
+}
+
+void TestErrorCopy() {
+  auto& single_flight = ZRpcSingleFlight::GetInstance();
+  
+  folly::Promise<ProtoRpcResponsePtr> p;
+  auto call = [&]() {
+    return p.getFuture();
+  };
+  
+  auto request = MakeRequest(2001, "error");
+  auto key = ZRpcRequestKey::Make("test_service", request, false);
+  auto f1 = single_flight.Do(key, 2001, call);
+  auto f2 = single_flight.Do(key, 2002, call);
+  
+  auto error = std::make_shared<RpcError>();
+  error->req_message_id = 2001;
+  error->error_code = 500;
+  error->error_tag = "INTERNAL";
+  p.setValue(error);
+  
+  auto r = std::dynamic_pointer_cast<RpcError>(f2.value());
+  assert(r);
+  assert(r != error);
+  assert(r->req_message_id == 2002);
+  assert(r->error_code == 500);
+  assert(r->error_tag == "INTERNAL");
+  assert(f1.value() == error);
+  
+  std::cout << "TestErrorCopy> ok" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  TestFollowerCopy();
+  TestErrorCopy();
+  return 0;
+}
@@ -95,6 +95,11 @@ bool ThreadGroupListOption::SetConf(const std::string &conf_name, const Configur
     options.emplace_back(ThreadType::REDIS, static_cast<int>(redis->asInt()));
   }
   
+  auto cpu = config_data.get_ptr("cpu");
+  if (cpu && cpu->isInt()) {
+    options.emplace_back(ThreadType::CPU, static_cast<int>(cpu->asInt()));
+  }
+  
   return true;
 }
 
@@ -132,6 +137,7 @@ ThreadGroupPtr ThreadGroupListManager::MakeThreadGroup(ThreadType thread_type, i
         break;
     case ThreadType::DB:
     case ThreadType::REDIS:
+    case ThreadType::CPU:
         pool = std::make_shared<wangle::CPUThreadPoolExecutor>(thread_size);
         break;
     default:
@@ -163,6 +169,9 @@ ThreadGroupPtr ThreadGroupListManager::MakeThreadGroup(ThreadType thread_type, i
       
       LOG(INFO) << "MakeThreadGroup - thread_type: " << ToString(thread_type) << ", thread_idx: " << idx;
       thread_datas_.emplace_back(group, idx, evb);
+      if (evb) {
+        thread_datas_.back().mailbox = std::make_shared<ConnWriteMailbox>(evb);
+      }
       return idx;
     };
     
@@ -34,6 +34,7 @@
 #include <wangle/concurrent/IOThreadPoolExecutor.h>
 
 #include "nebula/base/configurable.h"
+#include "nebula/net/conn_write_mailbox.h"
 
 namespace nebula {
 
@@ -47,6 +48,7 @@ namespace nebula {
 // fiber
 // db
 // redis
+// cpu
 enum class ThreadType : int {
   NORMAL = 1,         // 普通线程
   CONN_ACCEPT = 2,    // Accept, 需要EventBase支持
@@ -55,7 +57,8 @@ enum class ThreadType : int {
   FIBER = 8,          // 协程, 需要EventBase支持
   DB = 16,            // DB
   REDIS = 32,         // REDIS
-  MAX = 33,
+  CPU = 64,           // 计算, 不需要EventBase
+  MAX = 65,
 };
 
 inline const char* ToString(ThreadType thread_type) {
@@ -83,6 +86,9 @@ inline const char* ToString(ThreadType thread_type) {
     case ThreadType::REDIS:
       s = "REDIS";
       break;
+    case ThreadType::CPU:
+      s = "CPU";
+      break;
     default:
       break;
   }
@@ -162,6 +168,8 @@ struct ThreadData {
   // ThreadType thread_type;         //
   size_t thread_idx {0};               // 线程ID
   folly::EventBase* evb {nullptr};          // evb
+  // 有evb的线程才有, 跨线程发送用
+  std::shared_ptr<ConnWriteMailbox> mailbox;
 };
 
 
@@ -187,7 +195,8 @@ struct ThreadData {
     "conn"   : 4,
     "fiber"  : 4,
     "db"     : 4,
-    "redis"  : 4
+    "redis"  : 4,
+    "cpu"    : 4
  }
  */
 // 初始化线程列表
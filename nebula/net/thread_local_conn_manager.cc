@@ -25,30 +25,74 @@ namespace nebula {
 ///////////////////////////////////////////////////////////////////////////////////////
 // EventBase线程里执行
 uint64_t ThreadLocalConnManager::OnNewConnection(wangle::PipelineBase* pipeline) {
-    uint32_t conn_id = 0;
-    bool sucess = false;
-    do {
-        conn_id = ++current_conn_id_;
-        // 保证conn_id不为0
-        if (conn_id == 0) ++current_conn_id_;
-        sucess = pipelines_.insert(std::make_pair(conn_id, pipeline)).second;
-    } while(!sucess);
+    uint32_t index = 0;
+    if (free_head_ != kInvalidDenseIndex) {
+        index = free_head_;
+        free_head_ = slots_[index].next_free;
+        if (free_head_ == kInvalidDenseIndex) free_tail_ = kInvalidDenseIndex;
+    } else if (slots_.size() < kMaxSlots) {
+        index = static_cast<uint32_t>(slots_.size());
+        slots_.emplace_back();
+    } else {
+        LOG(ERROR) << "OnNewConnection - too many conns, thread_id: " << thread_id_;
+        return 0;
+    }
     
-    return static_cast<uint64_t>(thread_id_) << 32 | conn_id;
+    auto& slot = slots_[index];
+    uint32_t local_id = slot.generation << kSlotIndexBits | index;
+    slot.dense_index = static_cast<uint32_t>(live_conns_.size());
+    slot.next_free = kInvalidDenseIndex;
+    live_conns_.push_back(LiveConn{local_id, pipeline});
+    
+    return static_cast<uint64_t>(thread_id_) << 32 | local_id;
 }
 
 // EventBase线程里执行
 bool ThreadLocalConnManager::OnConnectionClosed(uint64_t conn_id) {
-    // auto it = pipelines_.find(conn_id & 0xffffffff);
-    bool rv = true;
-    auto it = pipelines_.find(conn_id & 0xffffffff);
-    if (it!=pipelines_.end()) {
-        pipelines_.erase(it);
-    } else {
-        rv = false;
+    uint32_t local_id = static_cast<uint32_t>(conn_id);
+    uint32_t index = local_id & kSlotIndexMask;
+    if (conn_id >> 32 != thread_id_ ||
+        index >= slots_.size() ||
+        slots_[index].generation != local_id >> kSlotIndexBits ||
+        slots_[index].dense_index == kInvalidDenseIndex) {
         LOG(ERROR) << "OnConnectionClosed - not find conn_id: " << conn_id;
+        return false;
+    }
+    
+    auto& slot = slots_[index];
+    // 和最后一个交换后删除
+    uint32_t dense_index = slot.dense_index;
+    if (dense_index + 1 != live_conns_.size()) {
+        live_conns_[dense_index] = live_conns_.back();
+        slots_[live_conns_[dense_index].local_id & kSlotIndexMask].dense_index = dense_index;
+    }
+    live_conns_.pop_back();
+    
+    slot.dense_index = kInvalidDenseIndex;
+    slot.generation = (slot.generation + 1) & kGenerationMask;
+    if (slot.generation == 0) slot.generation = 1;
+    
+    // 放到空闲链表尾部
+    slot.next_free = kInvalidDenseIndex;
+    if (free_tail_ == kInvalidDenseIndex) {
+        free_head_ = index;
+    } else {
+        slots_[free_tail_].next_free = index;
+    }
+    free_tail_ = index;
+    
+    return true;
+}
+
+// 精度100ms, 空闲检查不需要更高的精度
+#define WHEEL_TIMER_TICK_INTERVAL 100
+
+folly::HHWheelTimer& ThreadLocalConnManager::GetWheelTimer() {
+    if (!wheel_timer_) {
+        auto evb = folly::EventBaseManager::get()->getEventBase();
+        wheel_timer_ = folly::HHWheelTimer::newTimer(evb, std::chrono::milliseconds(WHEEL_TIMER_TICK_INTERVAL));
     }
-    return rv;
+    return *wheel_timer_;
 }
 
 //bool ThreadLocalConnManager::SendIOBufByConnID(uint64_t conn_id, std::unique_ptr<folly::IOBuf> data) {
@@ -18,13 +18,15 @@
 #ifndef NET_THREAD_LOCAL_CONN_MANAGER_H_
 #define NET_THREAD_LOCAL_CONN_MANAGER_H_
 
+#include <vector>
+
 #include <folly/FBVector.h>
+#include <folly/io/async/HHWheelTimer.h>
 
 
 #include <wangle/concurrent/IOThreadPoolExecutor.h>
 #include <wangle/channel/Pipeline.h>
 
-#include "nebula/base/map_util.h"
 #include "nebula/net/base/tcp_conn_event_callback.h"
 
 namespace nebula {
@@ -61,26 +63,67 @@ public:
   /////////////////////////////////////////////////////////////////////////////////////
   wangle::PipelineBase* FindPipeline(uint64_t conn_id) {
     if (conn_id >> 32 != thread_id_) return nullptr;
-    return FindPtrOrNull(pipelines_, conn_id & 0xffffffff);
+    uint32_t local_id = static_cast<uint32_t>(conn_id);
+    uint32_t index = local_id & kSlotIndexMask;
+    if (index >= slots_.size()) return nullptr;
+    auto& slot = slots_[index];
+    // 连接已关闭或者slot已被复用
+    if (slot.generation != local_id >> kSlotIndexBits || slot.dense_index == kInvalidDenseIndex) {
+      return nullptr;
+    }
+    return live_conns_[slot.dense_index].pipeline;
+  }
+  
+  // 遍历本线程的所有连接, f里不能关闭连接
+  template <typename F>
+  void ForEachPipeline(F&& f) {
+    for (auto& v : live_conns_) {
+      f(static_cast<uint64_t>(thread_id_) << 32 | v.local_id, v.pipeline);
+    }
+  }
+  
+  inline size_t GetConnCount() const {
+    return live_conns_.size();
   }
   
+  // 本IO线程的时间轮, 第一次调用时在当前EventBase上创建
+  // 用于连接空闲检查等大量长周期定时器, 增删都是O(1)
+  folly::HHWheelTimer& GetWheelTimer();
+  
   // 发送给指定的连接ID
   // 低32位（本线程内的连接ID有效）
   // bool SendIOBufByConnID(uint64_t conn_id, std::unique_ptr<folly::IOBuf> data);
   
 protected:
-  inline uint32_t GetNextID() {
-    if (current_conn_id_ == 0) ++current_conn_id_;
-    return current_conn_id_++;
-  }
+  // conn_id低32位: generation(12位) << 20 | slot下标(20位)
+  //  generation从1开始, 保证低32位不为0
+  //  slot释放后generation加1, 旧的conn_id查不到新连接
+  //  空闲slot按先进先出复用, 同一个slot要间隔很久才会再次分配
+  static const uint32_t kSlotIndexBits = 20;
+  static const uint32_t kSlotIndexMask = (1u << kSlotIndexBits) - 1;
+  static const uint32_t kMaxSlots = 1u << kSlotIndexBits;
+  static const uint32_t kGenerationMask = (1u << (32 - kSlotIndexBits)) - 1;
+  static const uint32_t kInvalidDenseIndex = 0xffffffff;
   
-  // 用于计数（可以使用IDMap）
-  uint32_t current_conn_id_ {0};      // 0为无效值
+  struct ConnSlot {
+    uint32_t generation {1};
+    uint32_t dense_index {kInvalidDenseIndex};    // 在live_conns_里的下标
+    uint32_t next_free {kInvalidDenseIndex};
+  };
+  
+  // 存活的连接连续存放, 删除时和最后一个交换
+  struct LiveConn {
+    uint32_t local_id;
+    wangle::PipelineBase* pipeline;
+  };
   
-  // TODO(@benqi): 使用boost::multi_index_container进行管理
-  //   需要考虑性能，操作比较频繁
   size_t thread_id_ {0};  // 线程ID
-  std::unordered_map<uint32_t, wangle::PipelineBase*> pipelines_;
+  std::vector<ConnSlot> slots_;
+  std::vector<LiveConn> live_conns_;
+  uint32_t free_head_ {kInvalidDenseIndex};
+  uint32_t free_tail_ {kInvalidDenseIndex};
+  
+  folly::HHWheelTimer::UniquePtr wheel_timer_;
   // std::unordered_map<std::string, std::unordered_set<uint32_t>> service_pipelines_;
 };
 
@@ -39,6 +39,8 @@ REGISTER_PACKAGE(EncodedRpcOk);
 REGISTER_PACKAGE(RpcFloodWait);
 REGISTER_PACKAGE(RpcError);
 REGISTER_PACKAGE(RpcInternalError);
+REGISTER_PACKAGE(RpcStreamPush);
+REGISTER_PACKAGE(RpcStreamCredit);
 
 REGISTER_PACKAGE(EncodedPush);
 REGISTER_PACKAGE(MessageAck);
@@ -85,6 +87,28 @@ std::string AttachDataMessage::ToString() const {
   return oss.str();
 }
 
+void AttachDataMessage::Encode(IOBufWriter& iobw) const {
+  iobw.writeBE(proto_revision);
+  iobw.writeBE(birth_timetick);
+  iobw.writeBE(birth_track_uuid);
+  WriteString(iobw, birth_from);
+  iobw.writeBE(birth_server_id);
+  iobw.writeBE(birth_conn_id);
+  WriteString(iobw, birth_remote_ip);
+  
+  // write options
+  iobw.writeBE((uint32_t)options.size());
+  for (auto& v : options) {
+    iobw.writeBE(v.type);
+    if (v.type == 0) {
+      iobw.writeBE(v.data.n);
+    } else {
+      WriteString(iobw, *v.data.s);
+    }
+  }
+  // WriteMapStringString(iobw, attachx_data.options);
+}
+
 bool Package::Decode(ProtoRawData& proto_raw_data) {
   message.swap(proto_raw_data.message_data);
   try {
@@ -126,7 +150,9 @@ bool Package::Decode(ProtoRawData& proto_raw_data) {
       package_type = c.readBE<uint8_t>();
     }
     
-    nebula::io_buf_util::TrimStart(message.get(), HEADER_LEN);
+    // 带附加数据时包头不止HEADER_LEN
+    auto header_len = message->computeChainDataLength() - c.totalLength();
+    nebula::io_buf_util::TrimStart(message.get(), header_len);
   } catch(...) {
     // TODO(@wubenqi): error's log
     return false;
@@ -151,29 +177,6 @@ bool PackageMessage::SerializeToIOBuf(std::unique_ptr<folly::IOBuf>& io_buf) con
     iobw.writeBE((uint8_t)0);
     iobw.writeBE((uint16_t)0);
     
-    if (_has_attach_data) {
-      iobw.writeBE((uint8_t)Package::ATTACH_DATA_MESSAGE);
-      iobw.writeBE(attach_data.proto_revision);
-      iobw.writeBE(attach_data.birth_timetick);
-      iobw.writeBE(attach_data.birth_track_uuid);
-      WriteString(iobw, attach_data.birth_from);
-      iobw.writeBE(attach_data.birth_server_id);
-      iobw.writeBE(attach_data.birth_conn_id);
-      WriteString(iobw, attach_data.birth_remote_ip);
-      
-      // write options
-      iobw.writeBE((uint32_t)attach_data.options.size());
-      for (auto& v : attach_data.options) {
-        iobw.writeBE(v.type);
-        if (v.type == 0) {
-          iobw.writeBE(v.data.n);
-        } else {
-          WriteString(iobw, *v.data.s);
-        }
-      }
-      // WriteMapStringString(iobw, attachx_data.options);
-    }
-    
     // iobw.writeBE(GetPackageType());
     
     Encode(iobw);
@@ -197,6 +200,82 @@ bool PackageMessage::SerializeToIOBuf(std::unique_ptr<folly::IOBuf>& io_buf) con
   return rv;
 }
 
+bool Container::Decode(Package& package) {
+  PackageMessage::Decode(package);
+  try {
+    folly::io::Cursor c(package.message.get());
+    uint32_t count = c.readBE<uint32_t>();
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t len = c.readBE<uint32_t>();
+      
+      ProtoRawData raw_data;
+      c.clone(raw_data.message_data, len);
+      
+      Package child;
+      if (!child.Decode(raw_data)) {
+        LOG(ERROR) << "Decode - container's child package decode error";
+        return false;
+      }
+      
+      // 不支持嵌套
+      auto message_data = PackageFactory::CreateSharedInstance(child.package_type);
+      if (!message_data ||
+          child.package_type == Package::CONTAINER ||
+          !message_data->Decode(child)) {
+        LOG(ERROR) << "Decode - container's child package_message error, package_type: "
+                    << static_cast<int>(child.package_type);
+        return false;
+      }
+      data.push_back(message_data);
+    }
+  } catch(...) {
+    LOG(ERROR) << "Decode - container decode error";
+    return false;
+  }
+  return true;
+}
+
+void Container::Encode(IOBufWriter& iobw) const {
+  PackageMessage::Encode(iobw);
+  iobw.writeBE(static_cast<uint32_t>(data.size()));
+  for (auto& v : data) {
+    // 先编码到临时buffer里得到长度
+    auto child = folly::IOBuf::create(256);
+    IOBufWriter child_iobw(child.get(), 256);
+    v->Encode(child_iobw);
+    
+    auto len = static_cast<uint32_t>(child->computeChainDataLength());
+    iobw.writeBE(len);
+    folly::io::Cursor c(child.get());
+    iobw.push(c, len);
+  }
+}
+
+PackageMessagePtr RecodePackageMessage(const PackageMessage& message) {
+  ProtoRawData raw_data;
+  try {
+    raw_data.message_data = folly::IOBuf::create(256);
+    IOBufWriter iobw(raw_data.message_data.get(), 256);
+    message.Encode(iobw);
+  } catch(const std::exception& e) {
+    LOG(ERROR) << "RecodePackageMessage - catch a threwn exception: " << folly::exceptionStr(e);
+    return nullptr;
+  }
+  
+  Package package;
+  if (!package.Decode(raw_data)) {
+    LOG(ERROR) << "RecodePackageMessage - decode package error";
+    return nullptr;
+  }
+  auto message_data = PackageFactory::CreateSharedInstance(package.package_type);
+  if (!message_data || !message_data->Decode(package)) {
+    LOG(ERROR) << "RecodePackageMessage - decode package_message error, package_type: "
+                << static_cast<int>(package.package_type);
+    return nullptr;
+  }
+  return message_data;
+}
+
 std::string PackageMessage::ToString() const {
   if (_has_attach_data) {
     return folly::sformat("{{header:{{}}, attach_data:{{}}}}", package_header.ToString(), attach_data.ToString());
@@ -95,6 +95,8 @@ struct AttachDataMessage  {
   }
 
   std::string ToString() const;
+  // 不含ATTACH_DATA_MESSAGE类型字节
+  void Encode(IOBufWriter& iobw) const;
   
   // PackageMessagePtr child_package_message;
   // uint8_t chind_package_type;
@@ -166,6 +168,10 @@ struct Package {
     RPC_INTERNAL_ERROR = 0x33,
     
     PUSH = 0x34,
+    
+    // 流式RPC
+    RPC_STREAM_PUSH = 0x35,
+    RPC_STREAM_CREDIT = 0x36,
   };
   
   enum {
@@ -337,6 +343,11 @@ struct PackageMessage {
     iobw.writeBE(package_header.auth_id);
     iobw.writeBE(package_header.session_id);
     iobw.writeBE(package_header.message_id);
+    // 附带数据放在包头和真正的包类型之间, 见Package::Decode
+    if (_has_attach_data) {
+      iobw.writeBE((uint8_t)Package::ATTACH_DATA_MESSAGE);
+      attach_data.Encode(iobw);
+    }
     iobw.writeBE(GetPackageType());
   }
   
@@ -637,7 +648,14 @@ struct ProtoRpcResponse : public PackageMessage {
     return GetPackageType() == Package::RPC_OK ||
             GetPackageType() == Package::RPC_ERROR ||
             GetPackageType() == Package::RPC_FLOOD_WAIT ||
-            GetPackageType() == Package::RPC_INTERNAL_ERROR;
+            GetPackageType() == Package::RPC_INTERNAL_ERROR ||
+            GetPackageType() == Package::RPC_STREAM_PUSH;
+  }
+  
+  // 复制一份应答给另一个调用方(合并的请求, 缓存命中), payload共享底层buffer
+  //  只复制包头, 不复制attach_data, 不支持返回nullptr
+  virtual std::shared_ptr<ProtoRpcResponse> Clone() const {
+    return nullptr;
   }
 
   int64_t req_message_id {0};
@@ -678,6 +696,11 @@ struct RpcRequest : public ProtoRpcRequest {
   }
 
   virtual uint32_t GetMethodID() const = 0;
+  
+  // 复制一份请求用于对冲(同时发给多个后端), 不支持返回nullptr
+  virtual std::shared_ptr<RpcRequest> Clone() const {
+    return nullptr;
+  }
 
   // ID of API Method Request
   int32_t method_id; //: int
@@ -725,6 +748,43 @@ struct EncodedRpcRequest : public RpcRequest, public ProtoBox<EncodedMessage> {
   uint32_t GetMethodID() const override {
     return method_id;
   }
+  
+  // payload共享底层buffer, 不拷贝数据
+  std::shared_ptr<RpcRequest> Clone() const override {
+    auto r = std::make_shared<EncodedRpcRequest>();
+    r->package_header = package_header;
+    r->method_id = method_id;
+    
+    r->_has_attach_data = _has_attach_data;
+    if (_has_attach_data) {
+      r->attach_data.proto_revision = attach_data.proto_revision;
+      r->attach_data.birth_timetick = attach_data.birth_timetick;
+      r->attach_data.birth_track_uuid = attach_data.birth_track_uuid;
+      r->attach_data.birth_from = attach_data.birth_from;
+      r->attach_data.birth_server_id = attach_data.birth_server_id;
+      r->attach_data.birth_conn_id = attach_data.birth_conn_id;
+      r->attach_data.birth_remote_ip = attach_data.birth_remote_ip;
+      // OptionData析构时会释放字符串, 需要深拷贝
+      // 先reserve, 避免vector扩容时拷贝析构
+      r->attach_data.options.reserve(attach_data.options.size());
+      for (auto& v : attach_data.options) {
+        r->attach_data.options.emplace_back();
+        auto& o = r->attach_data.options.back();
+        o.type = v.type;
+        if (v.type == 1) {
+          o.data.s = new std::string(*v.data.s);
+        } else {
+          o.data.n = v.data.n;
+        }
+      }
+    }
+    
+    if (message.payload) {
+      auto payload = message.payload->clone();
+      r->message.SwapPayload(payload);
+    }
+    return r;
+  }
 
   virtual std::string ToString() const override {
     return folly::sformat("{{base: {}, method_id: {}, encoded: {}}}",
@@ -811,6 +871,18 @@ struct EncodedRpcOk : public RpcOk, public ProtoBox<EncodedMessage> {
   uint32_t GetMethodResponseID() const override {
     return method_response_id;
   }
+  
+  std::shared_ptr<ProtoRpcResponse> Clone() const override {
+    auto r = std::make_shared<EncodedRpcOk>();
+    r->package_header = package_header;
+    r->req_message_id = req_message_id;
+    r->method_response_id = method_response_id;
+    if (message.payload) {
+      auto payload = message.payload->clone();
+      r->message.SwapPayload(payload);
+    }
+    return r;
+  }
 
   virtual std::string ToString() const override {
     return folly::sformat("{{base: {}, req_message_id: {}, method_response_id: {}, encoded: {}}}",
@@ -884,6 +956,18 @@ struct RpcError : public ProtoRpcResponse {
     iobw.push((const uint8_t*)error_data.data(), error_data.length());
   }
   
+  std::shared_ptr<ProtoRpcResponse> Clone() const override {
+    auto r = std::make_shared<RpcError>();
+    r->package_header = package_header;
+    r->req_message_id = req_message_id;
+    r->error_code = error_code;
+    r->error_tag = error_tag;
+    r->user_message = user_message;
+    r->can_try_again = can_try_again;
+    r->error_data = error_data;
+    return r;
+  }
+  
 //  virtual std::string ToString() const override {
 //    return folly::sformat("{{base: {}, method_response_id: {}, encoded: {{}}}}}",
 //                          RpcOk::ToString(),
@@ -917,6 +1001,9 @@ struct RpcFloodWait : public ProtoRpcResponse {
   RpcFloodWait() = default;
   explicit RpcFloodWait(int32_t _delay)
     : delay(_delay) {}
+  RpcFloodWait(int64_t _req_message_id, int32_t _delay)
+    : ProtoRpcResponse(_req_message_id),
+      delay(_delay) {}
   
   uint8_t GetPackageType() const override {
     return HEADER;
@@ -945,6 +1032,18 @@ struct RpcFloodWait : public ProtoRpcResponse {
     iobw.writeBE(delay);
   }
   
+  std::shared_ptr<ProtoRpcResponse> Clone() const override {
+    auto r = std::make_shared<RpcFloodWait>(req_message_id, delay);
+    r->package_header = package_header;
+    return r;
+  }
+  
+  virtual std::string ToString() const override {
+    return folly::sformat("{{req_message_id: {}, delay: {}}}",
+                          req_message_id,
+                          delay);
+  }
+  
   // int64_t req_message_id;
   // Repeat delay on seconds
   int32_t delay {0};
@@ -1002,6 +1101,14 @@ struct RpcInternalError : public ProtoRpcResponse {
     iobw.writeBE(try_again_delay);
   }
   
+  std::shared_ptr<ProtoRpcResponse> Clone() const override {
+    auto r = std::make_shared<RpcInternalError>(req_message_id);
+    r->package_header = package_header;
+    r->can_try_again = can_try_again;
+    r->try_again_delay = try_again_delay;
+    return r;
+  }
+  
   virtual std::string ToString() const override {
     return folly::sformat("{{req_message_id: {}, can_try_again: {}, try_again_delay: {}}}",
                           req_message_id,
@@ -1014,6 +1121,128 @@ struct RpcInternalError : public ProtoRpcResponse {
   int32_t try_again_delay; //: int
 };
 
+///////////////////////////////////////////////////////////////////////////////////////
+// 流式RPC
+//  1. 客户端发送一个RpcRequest打开流
+//  2. 服务端返回若干RpcStreamPush, 通过req_message_id关联, seq从0递增
+//  3. 服务端以RpcOk/RpcError等普通应答结束
+// 流控: 服务端每发一个RpcStreamPush消耗一个credit, credit用完后暂停发送,
+// 客户端消费后通过RpcStreamCredit补充, 初始credit为kDefaultStreamWindow
+struct RpcStreamPush : public ProtoRpcResponse, public ProtoBox<EncodedMessage> {
+  enum {
+    HEADER = Package::RPC_STREAM_PUSH,
+  };
+  
+  RpcStreamPush() = default;
+  RpcStreamPush(int64_t _req_message_id, uint32_t _seq)
+    : ProtoRpcResponse(_req_message_id),
+      seq(_seq) {}
+  
+  uint8_t GetPackageType() const override {
+    return HEADER;
+  }
+  
+  bool Decode(Package& package) override {
+    PackageMessage::Decode(package);
+    try {
+      folly::io::Cursor c(package.message.get());
+      req_message_id = c.readBE<int64_t>();
+      seq = c.readBE<uint32_t>();
+      nebula::io_buf_util::TrimStart(package.message.get(), sizeof(req_message_id) + sizeof(seq));
+      message.Decode(package);
+    } catch(...) {
+      // TODO(@benqi): error's log
+      return false;
+    }
+    return true;
+  }
+  
+  uint32_t CalcPackageSize() const override {
+    return sizeof(req_message_id) + sizeof(seq) + message.ByteSize();
+  }
+  
+  void Encode(IOBufWriter& iobw) const override {
+    try {
+      PackageMessage::Encode(iobw);
+      iobw.writeBE(req_message_id);
+      iobw.writeBE(seq);
+      message.Encode(iobw);
+    } catch(...) {
+    }
+  }
+  
+  virtual std::string ToString() const override {
+    return folly::sformat("{{req_message_id: {}, seq: {}, encoded: {}}}",
+                          req_message_id,
+                          seq,
+                          message.ToString());
+  }
+  
+  // int64_t req_message_id;
+  uint32_t seq {0};
+};
+
+// 客户端补充流的credit
+// 走客户端的请求pipeline, 所以从RpcRequest派生, 但不会投递给服务
+struct RpcStreamCredit : public RpcRequest {
+  enum {
+    HEADER = Package::RPC_STREAM_CREDIT,
+  };
+  
+  // 服务端初始credit
+  enum {
+    kDefaultStreamWindow = 32,
+  };
+  
+  RpcStreamCredit() = default;
+  RpcStreamCredit(int64_t _req_message_id, uint32_t _credits)
+    : req_message_id(_req_message_id),
+      credits(_credits) {
+    method_id = 0;
+  }
+  
+  uint8_t GetPackageType() const override {
+    return HEADER;
+  }
+  
+  bool Decode(Package& package) override {
+    PackageMessage::Decode(package);
+    method_id = 0;
+    try {
+      folly::io::Cursor c(package.message.get());
+      req_message_id = c.readBE<int64_t>();
+      credits = c.readBE<uint32_t>();
+    } catch(...) {
+      // TODO(@benqi): error's log
+      return false;
+    }
+    return true;
+  }
+  
+  uint32_t CalcPackageSize() const override {
+    return sizeof(req_message_id) + sizeof(credits);
+  }
+  
+  void Encode(IOBufWriter& iobw) const override {
+    PackageMessage::Encode(iobw);
+    iobw.writeBE(req_message_id);
+    iobw.writeBE(credits);
+  }
+  
+  uint32_t GetMethodID() const override {
+    return 0;
+  }
+  
+  virtual std::string ToString() const override {
+    return folly::sformat("{{req_message_id: {}, credits: {}}}",
+                          req_message_id,
+                          credits);
+  }
+  
+  int64_t req_message_id {0};
+  uint32_t credits {0};
+};
+
 struct Push : public ProtoPush {
   bool Decode(Package& package) override {
     PackageMessage::Decode(package);
@@ -1267,9 +1496,16 @@ struct Container : public PackageMessage {
     return HEADER;
   }
   
-  bool Decode(Package& package) override {
-    PackageMessage::Decode(package);
-    return true;
+  // 格式: count(uint32) + count * [length(uint32) + package(不带frame和attach_data)]
+  bool Decode(Package& package) override;
+  void Encode(IOBufWriter& iobw) const override;
+  
+  uint32_t CalcPackageSize() const override {
+    uint32_t sz = PackageMessage::CalcPackageSize() + sizeof(uint32_t);
+    for (auto& v : data) {
+      sz += sizeof(uint32_t) + v->CalcPackageSize();
+    }
+    return sz;
   }
   
   // Messages count
@@ -1297,5 +1533,9 @@ struct AttachDataMessage : public PackageMessage {
 
 using PackageFactory = nebula::SelfRegisterFactoryManager<PackageMessage, uint8_t>;
 
+// 按网络上的格式(不带frame)编码后再解码, 得到的对象和对端收到的一样
+// 比如ApiRpcRequest<T>得到EncodedRpcRequest, 失败返回nullptr
+PackageMessagePtr RecodePackageMessage(const PackageMessage& message);
+
 #endif // NUBULA_NET_ZPROTO_ZPROTO_PACKAGE_DATA_H_
 